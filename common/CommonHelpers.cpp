@@ -26,7 +26,6 @@
 #include <common/CommonHelpers.h>
 
 #include <format>
-#include <map>
 #include <sddl.h>
 #include <string>
 #include <array>
@@ -89,38 +88,12 @@ std::wstring GetAppFolder()
     return folder.substr(0, folder.find_last_of(wds::chrBackslash));
 }
 
-constexpr DWORD SidGetLength(const PSID x)
-{
-    return sizeof(SID) + (static_cast<SID*>(x)->SubAuthorityCount - 1) * sizeof(static_cast<SID*>(x)->SubAuthority);
-}
-
 std::wstring GetNameFromSid(const PSID sid)
 {
     // return immediately if sid is null
     if (sid == nullptr) return L"";
 
-    // define custom lookup function
-    auto comp = [](const PSID p1, const PSID p2)
-    {
-        const DWORD l1 = SidGetLength(p1);
-        const DWORD l2 = SidGetLength(p2);
-        if (l1 != l2) return l1 < l2;
-        return memcmp(p1, p2, l1) > 0;
-    };
-
-    // attempt to lookup sid in cache
-    static std::map<PSID, std::wstring, decltype(comp)> nameMap(comp);
-    const auto iter = nameMap.find(sid);
-    if (iter != nameMap.end())
-    {
-        return iter->second;
-    }
-
-    // copy the sid for storage in our cache table
-    const DWORD sidLength = SidGetLength(sid);
-    const auto sidCopy = memcpy(malloc(sidLength), sid, sidLength);
-
-    // lookup the name for this sid
+    // lookup the name for this sid; callers cache the result
     SID_NAME_USE nameUse;
     WCHAR accountName[UNLEN + 1], domainName[UNLEN + 1];
     DWORD iAccountNameSize = _countof(accountName), iDomainName = _countof(domainName);
@@ -128,17 +101,12 @@ std::wstring GetNameFromSid(const PSID sid)
         &iAccountNameSize, domainName, &iDomainName, &nameUse) == 0)
     {
         SmartPointer<LPWSTR> sidBuff(LocalFree);
-        ConvertSidToStringSid(sid, &sidBuff);
-        nameMap[sidCopy] = sidBuff;
-    }
-    else
-    {
-        // generate full name in domain\name format
-        nameMap[sidCopy] = std::format(L"{}\\{}", domainName, accountName);
+        if (ConvertSidToStringSid(sid, &sidBuff) == 0) return L"";
+        return static_cast<LPWSTR>(sidBuff);
     }
 
-    // return name
-    return nameMap[sidCopy];
+    // generate full name in domain\name format
+    return std::format(L"{}\\{}", domainName, accountName);
 }
 
 IContextMenu* GetContextMenu(const HWND hwnd, const std::vector<std::wstring>& paths)
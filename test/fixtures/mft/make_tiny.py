@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+#
+# Generates tiny.mft, a synthetic $MFT extract for the decoder in
+# windirstat/MftDecoder.cpp. The expected tree is listed in tiny.txt.
+#
+
+import struct
+from pathlib import Path
+
+RECORD_SIZE = 1024
+SECTOR_SIZE = 512
+TIME = 133000000000000000  # 2022-06-14 as FILETIME ticks
+
+def ref(record, sequence):
+    return record | sequence << 48
+
+def attribute(type, body, resident=True, flags=0):
+    if resident:
+        header = struct.pack('<IIBBHHHIHBx', type, 0, 0, 0, 0, flags, 0, len(body), 0x18, 0)
+        data = header + body
+    else:
+        data = struct.pack('<IIBBHHH', type, 0, 1, 0, 0, flags, 0) + body
+    data += b'\0' * (-len(data) % 8)
+    return data[:4] + struct.pack('<I', len(data)) + data[8:]
+
+def standard_information(time, attributes=0):
+    return attribute(0x10, struct.pack('<QQQQI', time, time, time, time, attributes) + b'\0' * 0x1C)
+
+def file_name(parent, name, namespace=1):
+    encoded = name.encode('utf-16-le')
+    body = struct.pack('<QQQQQQQIIBB', parent, TIME, TIME, TIME, TIME, 0, 0, 0, 0, len(name), namespace)
+    return attribute(0x30, body + encoded)
+
+def resident_data(size):
+    return attribute(0x80, b'x' * size)
+
+def nonresident_data(logical, physical):
+    # Starting / last VCN, runlist offset, compression unit, allocated, real and initialized size
+    runs = bytes([0x11, physical // 4096, 0x10, 0])
+    body = struct.pack('<QQHH4xQQQ', 0, physical // 4096 - 1, 0x40, 0, physical, logical, logical) + runs
+    return attribute(0x80, body, resident=False)
+
+def volume_name(name):
+    return attribute(0x60, name.encode('utf-16-le'))
+
+def record(sequence, attributes, in_use=True, directory=False, base=0):
+    flags = (1 if in_use else 0) | (2 if directory else 0)
+    usa_offset, usa_count = 0x30, RECORD_SIZE // SECTOR_SIZE + 1
+    first = 0x38
+    body = b''.join(attributes) + struct.pack('<I', 0xFFFFFFFF)
+    header = struct.pack('<4sHHQHHHHIIQHxxI', b'FILE', usa_offset, usa_count, 0, sequence, 1, first, flags,
+        first + len(body) + 4, RECORD_SIZE, base, 0, 0)
+    data = bytearray(header.ljust(first, b'\0') + body)
+    data.extend(b'\0' * (RECORD_SIZE - len(data)))
+
+    # Protect the last two bytes of every sector with the update sequence number
+    usn = 0x0001
+    struct.pack_into('<H', data, usa_offset, usn)
+    for i in range(1, usa_count):
+        tail = i * SECTOR_SIZE - 2
+        data[usa_offset + i * 2:usa_offset + i * 2 + 2] = data[tail:tail + 2]
+        struct.pack_into('<H', data, tail, usn)
+    return bytes(data)
+
+ROOT = ref(5, 5)
+DOCS = ref(16, 1)
+
+records = [b'\0' * RECORD_SIZE] * 24
+records[0] = record(1, [standard_information(TIME, 0x6), file_name(ROOT, '$MFT', 3)])
+records[3] = record(3, [standard_information(TIME, 0x6), file_name(ROOT, '$Volume', 3), volume_name('FIXTURE')])
+records[5] = record(5, [standard_information(TIME, 0x6), file_name(ROOT, '.', 3)], directory=True)
+records[16] = record(1, [standard_information(TIME + 1), file_name(ROOT, 'docs')], directory=True)
+records[17] = record(1, [standard_information(TIME + 2), file_name(ROOT, 'A~1.TXT', 2),
+    file_name(ROOT, 'a.txt', 1), resident_data(10)])
+records[18] = record(1, [standard_information(TIME + 3), file_name(DOCS, 'b.bin'), nonresident_data(5000, 8192)])
+records[19] = record(2, [standard_information(TIME + 9), file_name(ROOT, 'gone.txt'), resident_data(7)], in_use=False)
+records[20] = record(1, [standard_information(TIME + 9), file_name(ref(16, 2), 'orphan.txt'), resident_data(7)])
+records[21] = record(1, [standard_information(TIME + 4), file_name(ROOT, 'c.dat'), file_name(DOCS, 'c-link.dat'),
+    nonresident_data(100, 4096)])
+records[22] = record(1, [nonresident_data(1000000, 1003520)], base=ref(23, 1))
+records[23] = record(1, [standard_information(TIME + 5), file_name(DOCS, 'big.iso')])
+
+Path(__file__).with_name('tiny.mft').write_bytes(b''.join(records))
@@ -1,29 +1,153 @@
 #pragma once
 
+#include "WorkStealingDeque.h"
+
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <thread>
 
 template <typename T>
 class BlockingQueue
 {
     std::vector<std::thread> m_Threads;
     std::deque<T> m_Queue;
+    std::deque<T> m_Urgent; // Items that run ahead of everything else
+    std::vector<std::unique_ptr<WorkStealingDeque<T>>> m_Deques;
     std::mutex m_Mutex;
     std::condition_variable m_Pushed;
     std::condition_variable m_Waiting;
-    unsigned int m_TotalWorkerThreads = 1;
-    unsigned int m_WorkersWaiting = 0;
-    bool m_Started = false;
-    bool m_Suspended = false;
-    bool m_Cancelled = false;
+    std::condition_variable m_Activated; // Wakes parked workers only so they never absorb a push notification
+    std::atomic<std::size_t> m_Pending = 0;  // Items in the shared queue and all worker deques
+    std::atomic<std::size_t> m_Injected = 0; // Items in the shared queue
+    std::atomic<std::size_t> m_UrgentCount = 0; // Items in the urgent queue
+    unsigned int m_TotalWorkerThreads = 1; // Workers started so far
+    unsigned int m_MaxWorkerThreads = 1;   // Workers that may be started on demand
+    std::function<void()> m_Callback;
+    std::atomic<unsigned int> m_ActiveWorkerThreads = 1; // Workers at or above this index stay parked
+    std::atomic<std::size_t> m_Progress = 0;             // Work units reported by the consumers
+    std::atomic<std::size_t> m_Generation = 0;           // Bumped whenever idle workers may find new work
+    std::atomic<unsigned int> m_WorkersWaiting = 0;
+    std::atomic<bool> m_Started = false;
+    std::atomic<bool> m_Suspended = false;
+    std::atomic<bool> m_Cancelled = false;
+    bool m_WorkStealing = false;
+
+    // Identifies the queue and deque owned by the current worker thread
+    static inline thread_local BlockingQueue* m_WorkerQueue = nullptr;
+    static inline thread_local unsigned int m_WorkerIndex = 0;
 
     bool AllThreadsIdling() const
     {
         return m_TotalWorkerThreads == m_WorkersWaiting;
     }
 
+    bool IsFinished() const
+    {
+        return m_Started && !m_Suspended && AllThreadsIdling() && m_Pending == 0 || m_Cancelled;
+    }
+
+    void ParkIfInactive()
+    {
+        if (m_WorkerIndex < m_ActiveWorkerThreads) return;
+
+        // Parked workers count as waiting; items left in their deque get stolen
+        std::unique_lock lock(m_Mutex);
+        m_WorkersWaiting++;
+        m_Waiting.notify_all();
+        m_Activated.wait(lock, [&]
+        {
+            return m_WorkerIndex < m_ActiveWorkerThreads || m_Cancelled;
+        });
+        m_WorkersWaiting--;
+    }
+
+    bool TryPopUrgent(T& value)
+    {
+        if (m_UrgentCount == 0) return false;
+
+        std::lock_guard lock(m_Mutex);
+        if (m_Urgent.empty()) return false;
+        value = m_Urgent.front();
+        m_Urgent.pop_front();
+        m_UrgentCount--;
+        return true;
+    }
+
+    bool TrySteal(T& value)
+    {
+        // Drain items pushed from outside the worker pool first
+        if (m_Injected > 0)
+        {
+            std::lock_guard lock(m_Mutex);
+            if (!m_Queue.empty())
+            {
+                value = m_Queue.front();
+                m_Queue.pop_front();
+                m_Injected--;
+                return true;
+            }
+        }
+
+        // Round robin over the other workers starting with our neighbor
+        const auto total = static_cast<unsigned int>(m_Deques.size());
+        for (auto i = 1u; i < total; i++)
+        {
+            if (m_Deques[(m_WorkerIndex + i) % total]->Steal(value)) return true;
+        }
+        return false;
+    }
+
+    bool HasStealableWork() const
+    {
+        return m_Injected > 0 || m_UrgentCount > 0 || std::ranges::any_of(m_Deques, [](const auto& deque)
+        {
+            return !deque->Empty();
+        });
+    }
+
+    T PopWorkStealing()
+    {
+        for (T value;;)
+        {
+            if (m_Cancelled)
+            {
+                throw std::exception(__FUNCTION__);
+            }
+
+            const auto generation = m_Generation.load();
+            if (!m_Suspended && (TryPopUrgent(value) || m_Deques[m_WorkerIndex]->PopBottom(value) || TrySteal(value)))
+            {
+                m_Pending--;
+                m_Started = true;
+                return value;
+            }
+
+            // A steal fails when another thief wins the race for the same item, so
+            // retry while items are left instead of waiting for the next push
+            if (!m_Suspended && HasStealableWork())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Park until something is pushed after the attempt above; items that
+            // are merely between being taken and counted do not wake anyone
+            std::unique_lock lock(m_Mutex);
+            m_WorkersWaiting++;
+            m_Waiting.notify_all();
+            m_Pushed.wait(lock, [&]
+            {
+                return !m_Suspended && m_Generation != generation || m_Cancelled;
+            });
+            m_WorkersWaiting--;
+        }
+    }
+
 public:
     BlockingQueue(const BlockingQueue&) = delete;
     BlockingQueue(BlockingQueue&&) = delete;
@@ -32,8 +156,14 @@ public:
     ~BlockingQueue() = default;
     BlockingQueue() = default;
 
-    void ThreadWrapper(const std::function<void()> & callback)
+    void ThreadWrapper(const std::function<void()> & callback, const unsigned int workerIndex)
     {
+        m_WorkerIndex = workerIndex;
+        if (m_WorkStealing)
+        {
+            m_WorkerQueue = this;
+        }
+
         try
         {
             callback();
@@ -45,28 +175,80 @@ public:
             m_WorkersWaiting++;
             m_Waiting.notify_all();
         }
+
+        m_WorkerQueue = nullptr;
     }
 
-    void StartThreads(const unsigned int workerThreads, const std::function<void()> & callback)
+    // Starts the given number of workers; SetActiveWorkerThreads() may start
+    // more later on, up to maxWorkerThreads
+    void StartThreads(const unsigned int workerThreads, const std::function<void()> & callback,
+        const bool workStealing = false, const unsigned int maxWorkerThreads = 0)
     {
         ResetQueue(workerThreads, false);
+        m_MaxWorkerThreads = std::max(workerThreads, maxWorkerThreads);
+        m_Callback = callback;
+
+        // Each worker gets its own deque that other workers may steal from; they
+        // exist for workers started later too so thieves never see the list change
+        m_WorkStealing = workStealing;
+        m_Deques.clear();
+        for (auto worker = 0u; m_WorkStealing && worker < m_MaxWorkerThreads; worker++)
+        {
+            m_Deques.emplace_back(std::make_unique<WorkStealingDeque<T>>());
+        }
 
         for (auto worker = 0u; worker < m_TotalWorkerThreads; worker++)
         {
-            m_Threads.emplace_back(&BlockingQueue::ThreadWrapper, this, callback);
+            m_Threads.emplace_back(&BlockingQueue::ThreadWrapper, this, m_Callback, worker);
         }
     }
 
     void Push(T const& value)
     {
+        // Workers push onto their own deque without taking the lock
+        if (m_WorkerQueue == this)
+        {
+            // Counted first so a thief taking it right away cannot drive the count below zero
+            m_Pending++;
+            m_Deques[m_WorkerIndex]->PushBottom(value);
+            m_Generation++;
+            if (m_WorkersWaiting > 0)
+            {
+                std::lock_guard lock(m_Mutex);
+                m_Pushed.notify_one();
+            }
+            return;
+        }
+
         // Push another entry onto the queue
         std::lock_guard lock(m_Mutex);
         m_Queue.push_front(value);
+        m_Injected++;
+        m_Pending++;
+        m_Generation++;
+        m_Pushed.notify_one();
+    }
+
+    // Queues an entry ahead of all others; it may also be queued normally so
+    // consumers must tolerate seeing the same entry more than once
+    void PushUrgent(T const& value)
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Urgent.push_back(value);
+        m_UrgentCount++;
+        m_Pending++;
+        m_Generation++;
         m_Pushed.notify_one();
     }
 
     T Pop()
     {
+        ParkIfInactive();
+        if (m_WorkerQueue == this)
+        {
+            return PopWorkStealing();
+        }
+
         // Record the worker is m_Waiting for an item until
         // the queue has something in it and we are not suspended
         std::unique_lock lock(m_Mutex);
@@ -74,7 +256,7 @@ public:
         m_Waiting.notify_all();
         m_Pushed.wait(lock, [&]
         {
-            return !m_Suspended && !m_Queue.empty() || m_Cancelled;
+            return !m_Suspended && (!m_Queue.empty() || !m_Urgent.empty()) || m_Cancelled;
         });
         m_WorkersWaiting--;
 
@@ -86,8 +268,19 @@ public:
 
         // Worker now has something to work on so pop it off the queue
         m_Started = true;
-        T& i = m_Queue.front();
+        if (!m_Urgent.empty())
+        {
+            T i = m_Urgent.front();
+            m_Urgent.pop_front();
+            m_UrgentCount--;
+            m_Pending--;
+            return i;
+        }
+
+        T i = m_Queue.front();
         m_Queue.pop_front();
+        m_Injected--;
+        m_Pending--;
         return i;
     }
 
@@ -118,18 +311,63 @@ public:
         std::unique_lock lock(m_Mutex);
         m_Waiting.wait(lock, [&]
         {
-            return m_Started && !m_Suspended && AllThreadsIdling() && m_Queue.empty() || m_Cancelled;
+            return IsFinished();
         });
 
         return !m_Cancelled;
     }
 
+    bool IsCompleteOrCancelled()
+    {
+        std::lock_guard lock(m_Mutex);
+        return IsFinished();
+    }
+
+    // Limits how many workers take items; the others stay parked. Workers
+    // are started the first time they are needed.
+    void SetActiveWorkerThreads(const unsigned int workerThreads)
+    {
+        std::lock_guard lock(m_Mutex);
+        m_ActiveWorkerThreads = std::clamp(workerThreads, 1u, m_MaxWorkerThreads);
+        while (!m_Cancelled && m_TotalWorkerThreads < m_ActiveWorkerThreads)
+        {
+            m_Threads.emplace_back(&BlockingQueue::ThreadWrapper, this, m_Callback, m_TotalWorkerThreads++);
+        }
+        m_Generation++; // Items left by workers that park become stealable
+        m_Activated.notify_all();
+        m_Pushed.notify_all();
+    }
+
+    unsigned int GetActiveWorkerThreads() const
+    {
+        return m_ActiveWorkerThreads;
+    }
+
+    void AddProgress(const std::size_t units)
+    {
+        m_Progress += units;
+    }
+
+    std::size_t GetProgress() const
+    {
+        return m_Progress;
+    }
+
+    std::size_t GetPending() const
+    {
+        return m_Pending;
+    }
+
     void CancelExecution()
     {
         // Start cancellation process
-        m_Cancelled = true;
-        m_Waiting.notify_all();
-        m_Pushed.notify_all();
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Cancelled = true;
+            m_Waiting.notify_all();
+            m_Pushed.notify_all();
+            m_Activated.notify_all();
+        }
 
         // Wait for threads to complete
         for (auto& thread : m_Threads)
@@ -161,6 +399,7 @@ public:
     {
         std::lock_guard lock(m_Mutex);
         m_Suspended = false;
+        m_Generation++;
         m_Waiting.notify_all();
         m_Pushed.notify_all();
     }
@@ -173,9 +412,19 @@ public:
         m_Started = false;
         m_Cancelled = false;
         m_TotalWorkerThreads = totalWorkerThreads;
+        m_MaxWorkerThreads = totalWorkerThreads;
+        m_ActiveWorkerThreads = totalWorkerThreads;
+        m_Progress = 0;
         m_Threads.clear();
         m_Threads.reserve(m_TotalWorkerThreads);
-        if (clearQueue) m_Queue.clear();
+        if (clearQueue)
+        {
+            m_Queue.clear();
+            m_Urgent.clear();
+            for (const auto& deque : m_Deques) deque->Clear();
+        }
+        m_Injected = m_Queue.size();
+        m_UrgentCount = m_Urgent.size();
+        m_Pending = m_Queue.size() + m_Urgent.size();
     }
 };
-
@@ -92,7 +92,8 @@ void CExtensionView::OnUpdate(CView* /*pSender*/, const LPARAM lHint, CObject*)
     {
     case HINT_NEWROOT:
     case HINT_NULL:
-        if (IsShowTypes() && GetDocument()->IsRootDone())
+    case HINT_EXTENSIONDATACHANGED:
+        if (IsShowTypes() && GetDocument()->HasRootItem())
         {
             m_ExtensionListControl.SetRootSize(GetDocument()->GetRootSize());
             m_ExtensionListControl.SetExtensionData(GetDocument()->GetExtensionData());
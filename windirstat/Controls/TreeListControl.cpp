@@ -450,6 +450,10 @@ void CTreeListControl::OnItemDoubleClick(const int i)
     ToggleExpansion(i);
 }
 
+void CTreeListControl::OnItemExpanded(CTreeListItem* /*item*/)
+{
+}
+
 void CTreeListControl::InitializeNodeBitmaps()
 {
     m_BmNodes0.DeleteObject();
@@ -772,6 +776,7 @@ void CTreeListControl::ExpandItem(const int i, const bool scroll)
 
     item->SetExpanded(true);
     RedrawItems(i, i);
+    OnItemExpanded(item);
 
     if (scroll)
     {
@@ -119,6 +119,15 @@ class CTreeListControl : public COwnerDrawnListControl
     void SysColorChanged() override;
     virtual void SetRootItem(CTreeListItem* root);
     void OnChildAdded(const CTreeListItem* parent, CTreeListItem* child);
+    template <class T> void OnChildrenAdded(const CTreeListItem* parent, const std::vector<T*>& children)
+    {
+        if (!parent->IsVisible() || !parent->IsExpanded()) return;
+
+        const int p = FindTreeItem(parent);
+        ASSERT(p != -1);
+        for (const auto& child : children) InsertItem(p + 1, child);
+        Sort();
+    }
     void OnChildRemoved(CTreeListItem* parent, CTreeListItem* child);
     void OnRemovingAllChildren(const CTreeListItem* parent);
     CTreeListItem* GetItem(int i) const;
@@ -161,6 +170,7 @@ class CTreeListControl : public COwnerDrawnListControl
 
 protected:
     virtual void OnItemDoubleClick(int i);
+    virtual void OnItemExpanded(CTreeListItem* item);
     void InitializeNodeBitmaps();
     void InsertItem(int i, CTreeListItem* item);
     void DeleteItem(int i);
@@ -202,10 +202,11 @@ void CTreeMapView::DrawHighlightExtension(CDC* pdc)
     CPen pen(PS_SOLID, 1, COptions::TreeMapHighlightColor);
     CSelectObject sopen(pdc, &pen);
     CSelectStockObject sobrush(pdc, NULL_BRUSH);
-    RecurseHighlightExtension(pdc, GetDocument()->GetZoomItem());
+    RecurseHighlightExtension(pdc, GetDocument()->GetZoomItem(),
+        CExtensionTable::Get()->Intern(GetDocument()->GetHighlightExtension()));
 }
 
-void CTreeMapView::RecurseHighlightExtension(CDC* pdc, const CItem* item)
+void CTreeMapView::RecurseHighlightExtension(CDC* pdc, const CItem* item, const CExtensionTable::Id ext)
 {
     CRect rc(item->TmiGetRectangle());
     if (rc.Width() <= 0 || rc.Height() <= 0)
@@ -215,7 +216,7 @@ void CTreeMapView::RecurseHighlightExtension(CDC* pdc, const CItem* item)
 
     if (item->TmiIsLeaf())
     {
-        if (item->IsType(IT_FILE) && _wcsicmp(item->GetExtension().c_str(), GetDocument()->GetHighlightExtension().c_str()) == 0)
+        if (item->IsType(IT_FILE) && item->GetExtensionId() == ext)
         {
             RenderHighlightRectangle(pdc, rc);
         }
@@ -230,7 +231,7 @@ void CTreeMapView::RecurseHighlightExtension(CDC* pdc, const CItem* item)
         {
             break;
         }
-        RecurseHighlightExtension(pdc, child);
+        RecurseHighlightExtension(pdc, child, ext);
     }
 }
 
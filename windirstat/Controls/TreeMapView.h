@@ -22,6 +22,7 @@
 #pragma once
 
 #include "TreeMap.h"
+#include "ExtensionTable.h"
 
 class CDirStatDoc;
 class CItem;
@@ -61,7 +62,7 @@ protected:
     void DrawHighlights(CDC* pdc);
 
     void DrawHighlightExtension(CDC* pdc);
-    void RecurseHighlightExtension(CDC* pdc, const CItem* item);
+    void RecurseHighlightExtension(CDC* pdc, const CItem* item, CExtensionTable::Id ext);
 
     void DrawSelection(CDC* pdc);
 
@@ -23,6 +23,7 @@
 #include "Item.h"
 #include "Localization.h"
 #include "CsvLoader.h"
+#include "OwnerCache.h"
 #include "Constants.h"
 
 #include <fstream>
@@ -34,6 +35,7 @@
 #include <chrono>
 #include <array>
 #include <ranges>
+#include <algorithm>
 
 enum
 {
@@ -178,31 +180,42 @@ CItem* LoadResults(const std::wstring & path)
             displayName = &displayName[1];
         }
 
-        // Create the tree item
-        CItem* newitem = new CItem(
-            type,
-            displayName,
-            FromTimeString(fields[orderMap[FIELD_LASTCHANGE]]),
-            _wcstoui64(fields[orderMap[FIELD_SIZE_PHYSICAL]].c_str(), nullptr, 10),
-            _wcstoui64(fields[orderMap[FIELD_SIZE_LOGICAL]].c_str(), nullptr, 10),
-            wcstoul(fields[orderMap[FIELD_ATTRIBUTES]].c_str(), nullptr, 16),
-            wcstoul(fields[orderMap[FIELD_FILES]].c_str(), nullptr, 10),
-            wcstoul(fields[orderMap[FIELDS_FOLDERS]].c_str(), nullptr, 10));
+        // Find the parent first as items are allocated from the arena of their parent
+        CItem* parent = nullptr;
+        if (isInRoot)
+        {
+            parent = newroot;
+        }
+        else if (auto found = parentMap.find(lookupPath); found != parentMap.end())
+        {
+            parent = found->second;
+        }
+
+        if (!isRoot && parent == nullptr)
+        {
+            ASSERT(FALSE);
+            continue;
+        }
 
+        // Create the tree item; the root is allocated normally as it owns the arena of the others
+        const FILETIME lastChange = FromTimeString(fields[orderMap[FIELD_LASTCHANGE]]);
+        const ULONGLONG sizePhysical = _wcstoui64(fields[orderMap[FIELD_SIZE_PHYSICAL]].c_str(), nullptr, 10);
+        const ULONGLONG sizeLogical = _wcstoui64(fields[orderMap[FIELD_SIZE_LOGICAL]].c_str(), nullptr, 10);
+        const DWORD attributes = wcstoul(fields[orderMap[FIELD_ATTRIBUTES]].c_str(), nullptr, 16);
+        const ULONG files = wcstoul(fields[orderMap[FIELD_FILES]].c_str(), nullptr, 10);
+        const ULONG folders = wcstoul(fields[orderMap[FIELDS_FOLDERS]].c_str(), nullptr, 10);
+        CItem* newitem = isRoot ?
+            ::new CItem(type, displayName, lastChange, sizePhysical, sizeLogical, attributes, files, folders) :
+            new (parent) CItem(type, displayName, lastChange, sizePhysical, sizeLogical, attributes, files, folders);
 
         if (isRoot)
         {
             newroot = newitem;
         }
-        else if (isInRoot)
-        {
-            newroot->AddChild(newitem, true);
-        }
-        else if (auto parent = parentMap.find(lookupPath); parent != parentMap.end())
+        else
         {
-            parent->second->AddChild(newitem, true);
+            parent->AddChild(newitem, true);
         }
-        else ASSERT(FALSE);
 
         if (!newitem->TmiIsLeaf() && newitem->GetItemsCount() > 0)
         {
@@ -243,6 +256,18 @@ bool SaveResults(const std::wstring& path, CItem * item)
     if (COptions::ShowColumnOwner)
     {
         cols.push_back(Localization::Lookup(IDS_COL_OWNER));
+
+        // Fetch all owners in parallel instead of one at a time while writing
+        std::vector<CItem*> items;
+        for (std::stack<CItem*> pending({ item }); !pending.empty();)
+        {
+            CItem* qitem = pending.top();
+            pending.pop();
+            items.push_back(qitem);
+            if (qitem->IsType(IT_FILE)) continue;
+            for (const auto& child : qitem->GetChildren()) pending.push(child);
+        }
+        COwnerCache::Get()->ResolveOwners(items);
     }
 
     // Output columns to file
@@ -292,3 +317,74 @@ bool SaveResults(const std::wstring& path, CItem * item)
     outf.close();
     return true;
 }
+
+bool SaveSlowestFolders(const std::wstring& path, CItem* item, const size_t count)
+{
+    std::ofstream outf;
+    outf.open(path, std::ios::binary);
+    if (!outf.is_open()) return false;
+
+    // Collect folders parents first so subtree times can be summed bottom up
+    struct Folder { const CItem* Item; ULONGLONG Subtree; };
+    std::vector<Folder> folders;
+    std::unordered_map<const CItem*, size_t> indexes;
+    for (std::stack<const CItem*> queue({ item }); !queue.empty();)
+    {
+        const CItem* qitem = queue.top();
+        queue.pop();
+        indexes.emplace(qitem, folders.size());
+        folders.push_back({ qitem, qitem->GetScanTime() });
+        for (const auto& child : qitem->GetChildren())
+        {
+            if (child->IsType(IT_MYCOMPUTER | IT_DRIVE | IT_DIRECTORY)) queue.push(child);
+        }
+    }
+    for (auto& folder : folders | std::views::reverse)
+    {
+        if (const auto parent = indexes.find(folder.Item->GetParent()); parent != indexes.end())
+        {
+            folders[parent->second].Subtree += folder.Subtree;
+        }
+    }
+
+    // Output header line to file
+    const std::vector<std::wstring> cols =
+    {
+        Localization::Lookup(IDS_SLOWEST_RANKING),
+        Localization::Lookup(IDS_COL_NAME),
+        Localization::Lookup(IDS_SLOWEST_OWN_TIME),
+        Localization::Lookup(IDS_SLOWEST_FILESYSTEM_TIME),
+        Localization::Lookup(IDS_SLOWEST_SUBTREE_TIME),
+        Localization::Lookup(IDS_COL_ITEMS)
+    };
+    for (unsigned int i = 0; i < cols.size(); i++)
+    {
+        outf << QuoteAndConvert(cols[i]) << ((i < cols.size() - 1) ? "," : "");
+    }
+    outf << "\r\n";
+
+    // Output the slowest folders by their own time and then by their subtree time
+    const auto output = [&](const UINT ranking, const auto& key)
+    {
+        const size_t n = std::min(count, folders.size());
+        std::ranges::partial_sort(folders, folders.begin() + static_cast<std::ptrdiff_t>(n),
+            [&key](const Folder& a, const Folder& b) { return key(a) > key(b); });
+        for (size_t i = 0; i < n; i++)
+        {
+            const CItem* folder = folders[i].Item;
+            const bool nonPathItem = folder->IsType(IT_MYCOMPUTER);
+            outf << std::format("{},{},{},{},{},{}\r\n",
+                QuoteAndConvert(Localization::Lookup(ranking)),
+                QuoteAndConvert(nonPathItem ? folder->GetName() : folder->GetPath()),
+                folder->GetScanTime(),
+                folder->GetScanFileSystemTime(),
+                folders[i].Subtree,
+                folder->GetChildren().size());
+        }
+    };
+    output(IDS_SLOWEST_OWN_TIME, [](const Folder& folder) { return folder.Item->GetScanTime(); });
+    output(IDS_SLOWEST_SUBTREE_TIME, [](const Folder& folder) { return folder.Subtree; });
+
+    outf.close();
+    return true;
+}
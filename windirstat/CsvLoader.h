@@ -25,4 +25,5 @@
 #include <string>
 
 bool SaveResults(const std::wstring& path, CItem* item);
+bool SaveSlowestFolders(const std::wstring& path, CItem* item, size_t count = 100);
 CItem* LoadResults(const std::wstring& path);
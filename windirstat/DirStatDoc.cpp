@@ -27,9 +27,14 @@
 #include "GlobalHelpers.h"
 #include "TreeMapView.h"
 #include "Item.h"
+#include "ItemReclaimer.h"
 #include "Localization.h"
 #include "MainFrame.h"
+#include "MftLoader.h"
 #include "ModalShellApi.h"
+#include "ScanCache.h"
+#include "ScanStatistics.h"
+#include "ScanTuner.h"
 #include "WinDirStat.h"
 #include <common/CommonHelpers.h>
 #include <common/MdExceptions.h>
@@ -54,6 +59,7 @@ CDirStatDoc::CDirStatDoc() :
 {
     ASSERT(nullptr == _theDocument);
     _theDocument = this;
+    CItem::SetObserver(this);
 
     VTRACE(L"sizeof(CItem) = {}", sizeof(CItem));
     VTRACE(L"sizeof(CTreeListItem) = {}", sizeof(CTreeListItem));
@@ -63,7 +69,9 @@ CDirStatDoc::CDirStatDoc() :
 
 CDirStatDoc::~CDirStatDoc()
 {
-    delete m_RootItem;
+    CItem::SetObserver(nullptr);
+    CItemReclaimer::Get()->Reclaim(m_RootItem);
+    CItemReclaimer::Get()->Drain();
     _theDocument = nullptr;
 }
 
@@ -73,6 +81,68 @@ CDirStatDoc* CDirStatDoc::GetDocument()
     return _theDocument;
 }
 
+void CDirStatDoc::OnChildAdded(CItem* parent, CItem* child)
+{
+    if (!parent->IsVisible() || !parent->IsExpanded()) return;
+
+    (void)parent->GetImage();
+    CMainFrame::Get()->InvokeInMessageThread([parent, child]
+    {
+        CFileTreeControl::Get()->OnChildAdded(parent, child);
+    });
+}
+
+void CDirStatDoc::OnChildrenAdded(CItem* parent, const std::vector<CItem*>& children)
+{
+    if (!parent->IsVisible() || !parent->IsExpanded()) return;
+
+    (void)parent->GetImage();
+    CMainFrame::Get()->InvokeInMessageThread([parent, &children]
+    {
+        CFileTreeControl::Get()->OnChildrenAdded(parent, children);
+    });
+}
+
+void CDirStatDoc::OnChildRemoved(CItem* parent, CItem* child)
+{
+    // The zoom belongs to the message thread; the child is deleted only
+    // once this returns so it can still be compared there
+    CMainFrame::Get()->InvokeInMessageThread([this, parent, child]
+    {
+        // Bring the zoom out if it would be invalidated
+        if (child == m_ZoomItem || child->IsAncestorOf(m_ZoomItem))
+        {
+            SetZoomItem(parent);
+        }
+
+        if (!parent->IsVisible()) return;
+        CFileTreeControl::Get()->OnChildRemoved(parent, child);
+    });
+}
+
+void CDirStatDoc::OnRemovingAllChildren(CItem* parent)
+{
+    CMainFrame::Get()->InvokeInMessageThread([parent]
+    {
+        CFileTreeControl::Get()->OnRemovingAllChildren(parent);
+    });
+}
+
+void CDirStatDoc::OnDuplicateCandidate(CItem* item, BlockingQueue<CItem*>* queue)
+{
+    CFileDupeControl::Get()->ProcessDuplicate(item, queue);
+}
+
+void CDirStatDoc::OnDuplicateCandidateRemoved(CItem* item)
+{
+    CFileDupeControl::Get()->RemoveItem(item);
+}
+
+const CItem* CDirStatDoc::GetPriorityItem() const
+{
+    return m_ZoomItem;
+}
+
 // Encodes a selection from the CSelectDrivesDlg into a string which can be routed as a pseudo
 // document "path" through MFC and finally arrives in OnOpenDocument().
 //
@@ -177,8 +247,11 @@ void CDirStatDoc::DeleteContents()
     StopScanningEngine();
 
     // Cleanup structures
-    delete m_RootItemDupe;
-    delete m_RootItem;
+    m_Watchers.clear();
+    m_RevalidateScanCache = false;
+    // Old trees are freed in the background so the next scan can start right away
+    CItemReclaimer::Get()->Reclaim(m_RootItemDupe);
+    CItemReclaimer::Get()->Reclaim(m_RootItem);
     m_RootItemDupe = nullptr;
     m_RootItem = nullptr;
     m_ZoomItem = nullptr;
@@ -198,9 +271,9 @@ BOOL CDirStatDoc::OnNewDocument()
 
 BOOL CDirStatDoc::OnOpenDocument(LPCWSTR lpszPathName)
 {
-    // Temporary minimize extra reviews
+    // Temporary minimize extra reviews; extension statistics are shown while scanning
     CMainFrame::Get()->MinimizeTreeMapView();
-    CMainFrame::Get()->MinimizeExtensionView();
+    CMainFrame::Get()->RestoreExtensionView();
 
     // Prepare for new root and delete any existing data
     CDocument::OnNewDocument();
@@ -235,10 +308,10 @@ BOOL CDirStatDoc::OnOpenDocument(LPCWSTR lpszPathName)
 
     if (m_ShowMyComputer)
     {
-        m_RootItem = new CItem(IT_MYCOMPUTER | ITF_ROOTITEM, Localization::Lookup(IDS_MYCOMPUTER));
+        m_RootItem = ::new CItem(IT_MYCOMPUTER | ITF_ROOTITEM, Localization::Lookup(IDS_MYCOMPUTER));
         for (const auto & rootFolder : rootFolders)
         {
-            const auto drive = new CItem(IT_DRIVE, rootFolder);
+            const auto drive = new (m_RootItem) CItem(IT_DRIVE, rootFolder);
             driveItems.emplace_back(drive);
             m_RootItem->AddChild(drive);
         }
@@ -246,7 +319,7 @@ BOOL CDirStatDoc::OnOpenDocument(LPCWSTR lpszPathName)
     else
     {
         const ITEMTYPE type = IsDrive(rootFolders[0]) ? IT_DRIVE : IT_DIRECTORY;
-        m_RootItem = new CItem(type | ITF_ROOTITEM, rootFolders[0]);
+        m_RootItem = ::new CItem(type | ITF_ROOTITEM, rootFolders[0]);
         if (m_RootItem->IsType(IT_DRIVE))
         {
             driveItems.emplace_back(m_RootItem);
@@ -267,7 +340,7 @@ BOOL CDirStatDoc::OnOpenDocument(LPCWSTR lpszPathName)
 BOOL CDirStatDoc::OnOpenDocument(CItem * newroot)
 {
     CMainFrame::Get()->MinimizeTreeMapView();
-    CMainFrame::Get()->MinimizeExtensionView();
+    CMainFrame::Get()->RestoreExtensionView();
 
     CDocument::OnNewDocument(); // --> DeleteContents()
 
@@ -304,11 +377,11 @@ void CDirStatDoc::SetTitlePrefix(const std::wstring& prefix) const
     CMainFrame::Get()->UpdateFrameTitleForDocument(docName.empty() ? nullptr : docName.c_str());
 }
 
-COLORREF CDirStatDoc::GetCushionColor(const std::wstring & ext)
+COLORREF CDirStatDoc::GetCushionColor(const CExtensionTable::Id ext)
 {
-    const auto& record = GetExtensionData()->find(ext);
-    VERIFY(record != GetExtensionData()->end());
-    return record->second.color;
+    const auto& data = *GetExtensionData();
+    VERIFY(ext < data.size());
+    return ext < data.size() ? data[ext].color : RGB(0, 0, 0);
 }
 
 COLORREF CDirStatDoc::GetZoomColor()
@@ -328,7 +401,6 @@ const CExtensionData* CDirStatDoc::GetExtensionData()
 ULONGLONG CDirStatDoc::GetRootSize() const
 {
     ASSERT(m_RootItem != nullptr);
-    ASSERT(IsRootDone());
     return m_RootItem->GetSizePhysical();
 }
 
@@ -355,6 +427,11 @@ bool CDirStatDoc::HasRootItem() const
     return m_RootItem != nullptr;
 }
 
+bool CDirStatDoc::IsOffline() const
+{
+    return HasRootItem() && m_RootItem->IsType(ITF_OFFLINE);
+}
+
 bool CDirStatDoc::IsRootDone() const
 {
     return HasRootItem() && m_RootItem->IsDone();
@@ -460,7 +537,7 @@ void CDirStatDoc::RecurseRefreshReparsePoints(CItem* item)
             }
 
             if (CReparsePoints::IsReparsePoint(child->GetAttributes()) &&
-                CDirStatApp::Get()->IsFollowingAllowed(child->GetPathLong(), child->GetAttributes()))
+                CDirStatApp::Get()->IsFollowingAllowed(child->GetPathLong(), child->GetAttributes(), child->GetReparseTag()))
             {
                 toRefresh.push_back(child);
             }
@@ -520,47 +597,43 @@ void CDirStatDoc::RefreshRecyclers() const
     if (!toRefresh.empty()) GetDocument()->StartScanningEngine(toRefresh);
 }
 
-void CDirStatDoc::RebuildExtensionData()
+void CDirStatDoc::RefreshExtensionData()
 {
-    CWaitCursor wc;
+    // Statistics are maintained while scanning so this is cheap enough to run periodically
+    m_ExtensionDataValid = false;
+    UpdateAllViews(nullptr, HINT_EXTENSIONDATACHANGED);
+}
 
+void CDirStatDoc::RebuildExtensionData()
+{
     m_ExtensionData.clear();
-    if (IsRootDone())
+    if (HasRootItem())
     {
         m_RootItem->CollectExtensionData(&m_ExtensionData);
     }
     
-    std::vector<std::wstring> sortedExtensions;
+    std::vector<CExtensionTable::Id> sortedExtensions;
     SortExtensionData(sortedExtensions);
     SetExtensionColors(sortedExtensions);
 
     m_ExtensionDataValid = true;
 }
 
-void CDirStatDoc::SortExtensionData(std::vector<std::wstring>& sortedExtensions)
+void CDirStatDoc::SortExtensionData(std::vector<CExtensionTable::Id>& sortedExtensions) const
 {
-    sortedExtensions.resize(m_ExtensionData.size());
-
-    for (int i = 0; const auto& ext : m_ExtensionData | std::views::keys)
+    sortedExtensions.clear();
+    for (CExtensionTable::Id ext = 0; ext < m_ExtensionData.size(); ext++)
     {
-        sortedExtensions[i++] = ext;
+        if (m_ExtensionData[ext].files > 0) sortedExtensions.push_back(ext);
     }
 
-    _pqsortExtensionData = &m_ExtensionData;
-    qsort(sortedExtensions.data(), sortedExtensions.size(), sizeof(std::wstring), [](const LPCVOID item1, const LPCVOID item2)
+    std::ranges::stable_sort(sortedExtensions, [this](const auto ext1, const auto ext2)
     {
-        const std::wstring &ext1 = *static_cast<const std::wstring*>(item1);
-        const std::wstring &ext2 = *static_cast<const std::wstring*>(item2);
-        const auto& r1 = _pqsortExtensionData->find(ext1);
-        const auto& r2 = _pqsortExtensionData->find(ext2);
-        ASSERT(r1 != _pqsortExtensionData->end());
-        ASSERT(r2 != _pqsortExtensionData->end());
-        return usignum(r2->second.bytes, r1->second.bytes);
+        return m_ExtensionData[ext1].bytes > m_ExtensionData[ext2].bytes;
     });
-    _pqsortExtensionData = nullptr;
 }
 
-void CDirStatDoc::SetExtensionColors(const std::vector<std::wstring>& sortedExtensions)
+void CDirStatDoc::SetExtensionColors(const std::vector<CExtensionTable::Id>& sortedExtensions)
 {
     static std::vector<COLORREF> colors;
 
@@ -580,8 +653,6 @@ void CDirStatDoc::SetExtensionColors(const std::vector<std::wstring>& sortedExte
     }
 }
 
-CExtensionData* CDirStatDoc::_pqsortExtensionData;
-
 // Deletes a file or directory via SHFileOperation.
 // Return: false, if canceled
 //
@@ -619,8 +690,11 @@ bool CDirStatDoc::DeletePhysicalItems(const std::vector<CItem*>& items, const bo
 
 void CDirStatDoc::SetZoomItem(CItem* item)
 {
+    // Scanning threads reach this only through CScanObserver, see OnChildRemoved()
+    ASSERT(CDirStatApp::Get()->m_nThreadID == GetCurrentThreadId());
     m_ZoomItem = item;
     UpdateAllViews(nullptr, HINT_ZOOMCHANGED);
+    PrioritizeScan(item, true);
 }
 
 // Starts a refresh of an item.
@@ -725,7 +799,7 @@ void CDirStatDoc::RecursiveUserDefinedCleanup(USERDEFINEDCLEANUP* udc, const std
         {
             continue;
         }
-        if (!CDirStatApp::Get()->IsFollowingAllowed(finder.GetFilePathLong(), finder.GetAttributes()))
+        if (!CDirStatApp::Get()->IsFollowingAllowed(finder.GetFilePathLong(), finder.GetAttributes(), finder.GetReparseTag()))
         {
             continue;
         }
@@ -859,6 +933,7 @@ void CDirStatDoc::OnUpdateCentralHandler(CCmdUI* pCmdUI)
         { ID_REFRESH_ALL,             { true,  true,  false, false, IT_ANY} },
         { ID_REFRESH_SELECTED,        { false, true,  false, false, IT_MYCOMPUTER | IT_DRIVE | IT_DIRECTORY | IT_FILE } },
         { ID_SAVE_RESULTS,            { true,  true,  false, false, IT_ANY} },
+        { ID_SAVE_SLOWEST,            { true,  true,  false, false, IT_ANY} },
         { ID_EDIT_COPY_CLIPBOARD,     { false, true,  true,  false, IT_DRIVE | IT_DIRECTORY | IT_FILE } },
         { ID_CLEANUP_EMPTY_BIN,       { true,  true,  false, false, IT_ANY} },
         { ID_TREEMAP_RESELECT_CHILD,  { true,  true,  true,  false, IT_ANY, reslectAvail } },
@@ -892,6 +967,14 @@ void CDirStatDoc::OnUpdateCentralHandler(CCmdUI* pCmdUI)
         return;
     }
 
+    // Commands that act on the paths of the items, which trees loaded from an image do not have
+    static const std::unordered_set<UINT> pathBased
+    {
+        ID_REFRESH_ALL, ID_REFRESH_SELECTED, ID_CLEANUP_EXPLORER_SELECT, ID_CLEANUP_OPEN_IN_CONSOLE,
+        ID_COMPRESS_NONE, ID_COMPRESS_LZNT1, ID_COMPRESS_XPRESS4K, ID_COMPRESS_XPRESS8K, ID_COMPRESS_XPRESS16K,
+        ID_COMPRESS_LZX, ID_CLEANUP_DELETE_BIN, ID_CLEANUP_DELETE, ID_CLEANUP_OPEN_SELECTED, ID_CLEANUP_PROPERTIES
+    };
+
     const auto& filter = filters[pCmdUI->m_nID];
     const auto& items = GetAllSelected();
 
@@ -900,6 +983,7 @@ void CDirStatDoc::OnUpdateCentralHandler(CCmdUI* pCmdUI)
     allow &= filter.allowNone || !items.empty();
     allow &= filter.allowMany || items.size() <= 1;
     allow &= filter.allowEarly || IsRootDone();
+    allow &= !pathBased.contains(pCmdUI->m_nID) || !IsOffline();
     if (items.empty()) allow &= filter.extra(nullptr);
     for (const auto& item : items)
     {
@@ -932,7 +1016,9 @@ BEGIN_MESSAGE_MAP(CDirStatDoc, CDocument)
     ON_COMMAMD_UPDATE_WRAPPER(ID_REFRESH_SELECTED, OnRefreshSelected)
     ON_COMMAMD_UPDATE_WRAPPER(ID_REFRESH_ALL, OnRefreshAll)
     ON_COMMAND(ID_LOAD_RESULTS, OnLoadResults)
+    ON_COMMAND(ID_LOAD_MFT, OnLoadMft)
     ON_COMMAMD_UPDATE_WRAPPER(ID_SAVE_RESULTS, OnSaveResults)
+    ON_COMMAMD_UPDATE_WRAPPER(ID_SAVE_SLOWEST, OnSaveSlowestFolders)
     ON_COMMAMD_UPDATE_WRAPPER(ID_EDIT_COPY_CLIPBOARD, OnEditCopy)
     ON_COMMAMD_UPDATE_WRAPPER(ID_CLEANUP_EMPTY_BIN, OnCleanupEmptyRecycleBin)
     ON_UPDATE_COMMAND_UI(ID_VIEW_SHOWFREESPACE, OnUpdateViewShowFreeSpace)
@@ -985,6 +1071,18 @@ void CDirStatDoc::OnSaveResults()
     SaveResults(dlg.GetPathName().GetString(), GetRootItem());
 }
 
+void CDirStatDoc::OnSaveSlowestFolders()
+{
+    // Request the file path from the user
+    std::wstring fileSelectString = std::format(L"{} (*.csv)|*.csv|{} (*.*)|*.*||",
+        Localization::Lookup(IDS_CSV_FILES), Localization::Lookup(IDS_ALL_FILES));
+    CFileDialog dlg(FALSE, L"csv", nullptr, OFN_EXPLORER | OFN_DONTADDTORECENT, fileSelectString.c_str());
+    if (dlg.DoModal() != IDOK) return;
+
+    CWaitCursor wc;
+    SaveSlowestFolders(dlg.GetPathName().GetString(), GetRootItem());
+}
+
 void CDirStatDoc::OnLoadResults()
 {
     // Request the file path from the user
@@ -998,6 +1096,19 @@ void CDirStatDoc::OnLoadResults()
     GetDocument()->OnOpenDocument(newroot);
 }
 
+void CDirStatDoc::OnLoadMft()
+{
+    // Request the $MFT extract or volume image from the user
+    std::wstring fileSelectString = std::format(L"{} (*.*)|*.*||", Localization::Lookup(IDS_ALL_FILES));
+    CFileDialog dlg(TRUE, nullptr, nullptr, OFN_EXPLORER | OFN_DONTADDTORECENT | OFN_PATHMUSTEXIST, fileSelectString.c_str());
+    if (dlg.DoModal() != IDOK) return;
+
+    CWaitCursor wc;
+    CItem* newroot = LoadMft(dlg.GetPathName().GetString());
+    if (newroot == nullptr) return;
+    GetDocument()->OnOpenDocument(newroot);
+}
+
 void CDirStatDoc::OnEditCopy()
 {
     // create concatenated paths
@@ -1223,7 +1334,8 @@ void CDirStatDoc::OnUpdateUserDefinedCleanup(CCmdUI* pCmdUI)
 {
     const int i = pCmdUI->m_nID - ID_USERDEFINEDCLEANUP0;
     const auto & items = GetAllSelected();
-    bool allowControl = (FileTreeHasFocus() || DupeListHasFocus()) && COptions::UserDefinedCleanups.at(i).Enabled && !items.empty();
+    bool allowControl = (FileTreeHasFocus() || DupeListHasFocus()) && COptions::UserDefinedCleanups.at(i).Enabled &&
+        !items.empty() && !IsOffline();
     if (allowControl) for (const auto & item : items)
     {
         allowControl &= UserDefinedCleanupWorksForItem(&COptions::UserDefinedCleanups[i], item);
@@ -1323,11 +1435,23 @@ void CDirStatDoc::OnCleanupCompress(UINT id)
     }
 }
 
+std::vector<BlockingQueue<CItem*>*> CDirStatDoc::GetScanQueues()
+{
+    // The wrapper thread builds m_queues so the UI only uses what it has published
+    std::lock_guard lock(m_ScanQueuesMutex);
+    std::vector<BlockingQueue<CItem*>*> queues;
+    for (const auto& queue : m_ScanQueues | std::views::values)
+    {
+        if (std::ranges::find(queues, queue) == queues.end()) queues.push_back(queue);
+    }
+    return queues;
+}
+
 void CDirStatDoc::OnScanSuspend()
 {
     // Wait for system to fully shutdown
-    for (auto& queue : m_queues | std::views::values)
-        ProcessMessagesUntilSignaled([&queue] { queue.SuspendExecution(); });
+    for (const auto& queue : GetScanQueues())
+        ProcessMessagesUntilSignaled([queue] { queue->SuspendExecution(); });
 
     // Mark as suspended
     if (CMainFrame::Get() != nullptr)
@@ -1336,8 +1460,8 @@ void CDirStatDoc::OnScanSuspend()
 
 void CDirStatDoc::OnScanResume()
 {
-    for (auto& queue : m_queues | std::views::values)
-        queue.ResumeExecution();
+    for (const auto& queue : GetScanQueues())
+        queue->ResumeExecution();
 
     if (CMainFrame::Get() != nullptr)
         CMainFrame::Get()->SuspendState(false);
@@ -1345,9 +1469,13 @@ void CDirStatDoc::OnScanResume()
 
 void CDirStatDoc::OnScanStop()
 {
-    // Stop m_queues from executing
-    for (auto& queue : m_queues | std::views::values)
-        ProcessMessagesUntilSignaled([&queue] { queue.CancelExecution(); });
+    // Stop m_queues from executing; queues not published yet are cancelled by the wrapper thread
+    {
+        std::lock_guard lock(m_ScanQueuesMutex);
+        m_ScanStopping = true;
+    }
+    for (const auto& queue : GetScanQueues())
+        ProcessMessagesUntilSignaled([queue] { queue->CancelExecution(); });
 
     // Wait for wrapper thread to complete
     if (m_thread != nullptr)
@@ -1356,12 +1484,140 @@ void CDirStatDoc::OnScanStop()
         ProcessMessagesUntilSignaled([this] { m_thread->join(); });
         delete m_thread;
         m_thread = nullptr;
+        {
+            std::lock_guard lock(m_ScanQueuesMutex);
+            m_ScanQueues.clear();
+        }
         m_queues.clear();
     }
 
     OnScanResume();
 }
 
+void CDirStatDoc::StartWatchingForChanges()
+{
+    if (!COptions::WatchForChanges || !m_Watchers.empty() || !HasRootItem() || IsOffline()) return;
+
+    // Watch each drive separately when several were scanned
+    const auto roots = m_RootItem->IsType(IT_MYCOMPUTER) ? m_RootItem->GetChildren() : std::vector{ m_RootItem };
+    for (const auto& root : roots)
+    {
+        if (!root->IsType(IT_DRIVE | IT_DIRECTORY)) continue;
+        m_Watchers.emplace_back(root, DirectoryWatcher::Create(root->GetPath()));
+    }
+}
+
+void CDirStatDoc::RefreshWatchedChanges()
+{
+    if (m_Watchers.empty() || !IsRootDone()) return;
+
+    // Resolve the reported folders to items; lost notifications require a full rescan
+    std::vector<CItem*> rescans;
+    std::vector<std::pair<int, CItem*>> folders;
+    for (const auto& [root, watcher] : m_Watchers)
+    {
+        bool overflow = false;
+        for (const auto& path : watcher->TakeChangedFolders(overflow))
+        {
+            CItem* item = root->FindDescendant(path);
+            if (item == nullptr) continue;
+
+            int depth = 0;
+            for (auto p = item; p != nullptr; p = p->GetParent()) depth++;
+            folders.emplace_back(depth, item);
+        }
+        if (overflow) rescans.push_back(root);
+    }
+
+    if (!rescans.empty())
+    {
+        RefreshItem(rescans);
+        return;
+    }
+    if (folders.empty()) return;
+
+    // Shallowest folders first so each one knows whether a changed ancestor covers it
+    std::ranges::sort(folders);
+    const auto [last, end] = std::ranges::unique(folders);
+    folders.erase(last, end);
+
+    // Only the topmost changed folders are queued; folders below them are
+    // reached through the merges on the way down, so a folder removed by the
+    // merge of its parent is never visited
+    std::unordered_set<CItem*> marked;
+    std::vector<CItem*> queued;
+    for (const auto& item : folders | std::views::values)
+    {
+        std::vector<CItem*> path{ item };
+        auto p = item->GetParent();
+        for (; p != nullptr && !marked.contains(p); p = p->GetParent()) path.push_back(p);
+        if (p == nullptr)
+        {
+            item->SetType(ITF_SHALLOW);
+            marked.insert(item);
+            queued.push_back(item);
+            continue;
+        }
+
+        for (const auto& folder : path)
+        {
+            folder->SetType(ITF_SHALLOW);
+            folder->SetType(ITF_DONE, false);
+            marked.insert(folder);
+        }
+    }
+
+    // The scanning threads enumerate the folders and the UI only applies the results
+    RefreshItem(queued);
+}
+
+void CDirStatDoc::RevalidateScanCache()
+{
+    if (!m_RevalidateScanCache || !IsRootDone()) return;
+
+    // Merging the whole tree with the disk only touches entries that changed
+    m_RevalidateScanCache = false;
+    RefreshItem(m_RootItem);
+}
+
+void CDirStatDoc::PrioritizeScan(CItem* item, const bool subtree)
+{
+    if (item == nullptr || item->IsDone() || item->IsType(IT_FILE)) return;
+
+    // Items are scanned by the queue of the scanned item they descend from
+    BlockingQueue<CItem*>* queue = nullptr;
+    {
+        std::lock_guard lock(m_ScanQueuesMutex);
+        for (auto p = item; p != nullptr && queue == nullptr; p = p->GetParent())
+        {
+            const auto match = std::ranges::find(m_ScanQueues, p, &decltype(m_ScanQueues)::value_type::first);
+            if (match != m_ScanQueues.end()) queue = match->second;
+        }
+    }
+    if (queue == nullptr) return;
+
+    // Only the unfinished part of the tree needs to be visited; entries
+    // already queued are dropped by the scanner once they have been enumerated
+    std::stack<std::pair<CItem*, bool>> pending({ { item, true } });
+    while (!pending.empty())
+    {
+        const auto [folder, descend] = pending.top();
+        pending.pop();
+
+        if (folder->IsScanPending())
+        {
+            queue->PushUrgent(folder);
+            continue;
+        }
+
+        if (!descend) continue;
+        for (const auto& child : folder->GetChildren())
+        {
+            if (!child->IsType(IT_FILE) && !child->IsDone()) pending.emplace(child, subtree);
+        }
+    }
+}
+
 void CDirStatDoc::StopScanningEngine()
 {
     OnScanStop();
@@ -1399,6 +1655,10 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
 {
     // Stop any previous executions
     StopScanningEngine();
+    {
+        std::lock_guard lock(m_ScanQueuesMutex);
+        m_ScanStopping = false;
+    }
 
     // Address currently zoomed / selected item conflicts
     const auto zoomItem = GetZoomItem();
@@ -1420,6 +1680,9 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
     // Clear any reselection options since they may be invalidated
     ClearReselectChildStack();
 
+    // Changes made while scanning are picked up once the scan completes
+    StartWatchingForChanges();
+
     // Do not attempt to update graph while scanning
     CMainFrame::Get()->GetTreeMapView()->SuspendRecalculationDrawing(true);
 
@@ -1438,13 +1701,25 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
             items = items.at(0)->GetChildren();
         }
 
+        // Cached listings are only trusted for new scans; refreshes re-enumerate
+        if (COptions::ScanningCache)
+        {
+            CScanCache::Get()->Load();
+            CScanCache::Get()->ResetCounters();
+            CScanCache::Get()->SetReadEnabled(std::ranges::none_of(items, [](const CItem* item) { return item->IsDone(); }));
+        }
+
         const auto selectedItems = GetAllSelected();
         using VisualInfo = struct { bool wasExpanded; bool isSelected; int oldScrollPosition; };
         std::unordered_map<CItem *,VisualInfo> visualInfo;
         for (auto item : std::vector(items))
         {
+            // Folders merged in place keep their children and duplicate state
+            const bool merge = (COptions::ScanningMergeRefresh || item->IsType(ITF_SHALLOW)) &&
+                item->IsDone() && item->IsType(IT_DRIVE | IT_DIRECTORY);
+
             // Clear items from duplicate list;
-            CFileDupeControl::Get()->RemoveItem(item);
+            if (!merge) CFileDupeControl::Get()->RemoveItem(item);
 
             // Record current visual arrangement to reapply afterward
             if (item->IsVisible())
@@ -1455,16 +1730,20 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
 
             // Skip pruning if it is a new element
             if (!item->IsDone()) continue;
-            item->UpwardRecalcLastChange(true);
-            item->UpwardSubtractSizePhysical(item->GetSizePhysical());
-            item->UpwardSubtractSizeLogical(item->GetSizeLogical());
-            item->UpwardSubtractFiles(item->GetFilesCount());
-            item->UpwardSubtractFolders(item->GetFoldersCount());
-            item->RemoveAllChildren();
+            const auto prune = [](CItem* prunedItem)
+            {
+                prunedItem->UpwardRecalcLastChange(true);
+                prunedItem->UpwardSubtractSizePhysical(prunedItem->GetSizePhysical());
+                prunedItem->UpwardSubtractSizeLogical(prunedItem->GetSizeLogical());
+                prunedItem->UpwardSubtractFiles(prunedItem->GetFilesCount());
+                prunedItem->UpwardSubtractFolders(prunedItem->GetFoldersCount());
+                prunedItem->RemoveAllChildren();
+            };
+            if (!merge) prune(item);
             item->UpwardSetUndone();
 
             // children removal will collapse item so re-expand it
-            if (visualInfo.contains(item) && item->IsVisible())
+            if (!merge && visualInfo.contains(item) && item->IsVisible())
                 item->SetExpanded(visualInfo[item].wasExpanded);
   
             // Handle if item to be refreshed has been removed
@@ -1474,6 +1753,11 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
             {
                 // Remove item from list so we do not rescan it
                 std::erase(items, item);
+                if (merge)
+                {
+                    CFileDupeControl::Get()->RemoveItem(item);
+                    prune(item);
+                }
 
                 if (item->IsRootItem())
                 {
@@ -1494,11 +1778,18 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
             }
         }
 
+        // Throughput counters cover this run only
+        std::vector<std::wstring> roots;
+        for (const auto& item : items) roots.push_back(item->GetPath());
+        CScanStatistics::Get()->Start(roots);
+
         // Add items to processing queue
+        CItem::BeginScanPass();
+        std::vector<std::pair<const CItem*, BlockingQueue<CItem*>*>> scanQueues;
         for (const auto & item : items)
         {
             // Skip any items we should not follow
-            if (!item->IsType(ITF_ROOTITEM) && !CDirStatApp::Get()->IsFollowingAllowed(item->GetPath(), item->GetAttributes()))
+            if (!item->IsType(ITF_ROOTITEM) && !CDirStatApp::Get()->IsFollowingAllowed(item->GetPath(), item->GetAttributes(), item->GetReparseTag()))
             {
                 continue;
             }
@@ -1517,24 +1808,51 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
             if (GetVolumePathName(item->GetPathLong().c_str(),
                 pathName.data(), static_cast<DWORD>(pathName.size())) != 0)
             {
-                m_queues[pathName.data()].Push(item);
+                auto& queue = m_queues[pathName.data()];
+                queue.Push(item);
+                scanQueues.emplace_back(item, &queue);
             }
             else ASSERT(FALSE);
         }
 
-        // Create subordinate threads if there is work to do
+        // Create subordinate threads if there is work to do; when tuning each
+        // volume starts with its share of the budget and may grow up to all of it
+        const bool autoTune = COptions::ScanningAutoTune;
+        std::vector<BlockingQueue<CItem*>*> queues;
         for (auto& queue : m_queues | std::views::values)
         {
-            queue.StartThreads(COptions::ScanningThreads, [&queue]()
+            queue.StartThreads(autoTune ? CScanTuner::GetInitialThreads(m_queues.size()) : COptions::ScanningThreads, [&queue]()
             {
                 CItem::ScanItems(&queue);
-            });
+            }, COptions::ScanningWorkStealing, autoTune ? CScanTuner::GetThreadBudget() : 0);
+            queues.push_back(&queue);
+        }
+
+        // Hand the queues to the UI thread only once they are complete
+        bool stopping = false;
+        {
+            std::lock_guard lock(m_ScanQueuesMutex);
+            m_ScanQueues = std::move(scanQueues);
+            stopping = m_ScanStopping;
         }
+        if (stopping) for (const auto& queue : queues) queue->CancelExecution();
+
+        // Adjust each volume's active workers while the scan gets going
+        CScanStatistics::Get()->SetQueues(queues);
+        CScanTuner tuner(queues);
+        if (autoTune) tuner.Start();
 
         // Wait for all threads to run out of work
         bool do_completion = true;
         for (auto& queue : m_queues | std::views::values)
             do_completion &= queue.WaitForCompletionOrCancellation();
+        tuner.Stop();
+        DirectoryHandleCache::Get()->Clear();
+        CScanStatistics::Get()->Stop();
+        if (const auto& statisticsFile = COptions::ScanStatisticsFile.Obj(); do_completion && !statisticsFile.empty())
+        {
+            CScanStatistics::Get()->SaveJson(statisticsFile);
+        }
         if (!do_completion)
         {
             // Sorting and other finalization tasks
@@ -1565,11 +1883,22 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
             }
         }
 
+        // Listings served from the cache are revalidated once the tree is shown
+        bool revalidate = false;
+        if (COptions::ScanningCache)
+        {
+            CScanCache::Get()->Save();
+            revalidate = CScanCache::Get()->GetHits() > 0;
+        }
+
         // Sorting and other finalization tasks
         CItem::ScanItemsFinalize(GetRootItem());
 
+        // Subtrees replaced by a refresh leave the extension statistics once deleted
+        CItemReclaimer::Get()->Drain();
+
         // Invoke a UI thread to do updates
-        CMainFrame::Get()->InvokeInMessageThread([&items,&visualInfo]
+        CMainFrame::Get()->InvokeInMessageThread([this,&items,&visualInfo,revalidate]
         {
             for (const auto& item : items)
             {
@@ -1586,6 +1915,7 @@ void CDirStatDoc::StartScanningEngine(std::vector<CItem*> items)
             CMainFrame::Get()->RestoreTreeMapView();
             CMainFrame::Get()->GetTreeMapView()->SuspendRecalculationDrawing(false);
             CMainFrame::Get()-> UnlockWindowUpdate();
+            m_RevalidateScanCache = revalidate;
         });
     });
 }
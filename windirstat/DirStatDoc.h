@@ -25,7 +25,12 @@
 #include "BlockingQueue.h"
 #include "Options.h"
 #include "CommonHelpers.h"
+#include "DirectoryWatcher.h"
+#include "ExtensionTable.h"
+#include "ScanObserver.h"
 
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -40,21 +45,6 @@ class CItemDupe;
 // 
 #define BASE_BRIGHTNESS 1.8
 
-//
-// Data stored for each extension.
-//
-struct SExtensionRecord
-{
-    ULONGLONG files;
-    ULONGLONG bytes;
-    COLORREF color;
-};
-
-//
-// Maps an extension (".bmp") to an SExtensionRecord.
-//
-using CExtensionData = std::unordered_map<std::wstring, SExtensionRecord>;
-
 //
 // Hints for UpdateAllViews()
 //
@@ -66,6 +56,7 @@ enum
     HINT_SELECTIONREFRESH,          // Inform all views to redraw based on current selections
     HINT_SELECTIONSTYLECHANGED,     // Only update selection in Graphview
     HINT_EXTENSIONSELECTIONCHANGED, // Type list selected a new extension
+    HINT_EXTENSIONDATACHANGED,      // Extension statistics changed while scanning
     HINT_ZOOMCHANGED,               // Only zoom item has changed.
     HINT_LISTSTYLECHANGED,          // Options: List style (grid/stripes) or treelist colors changed
     HINT_TREEMAPSTYLECHANGED        // Options: Treemap style (grid, colors etc.) changed
@@ -75,7 +66,7 @@ enum
 // CDirStatDoc. The "Document" class.
 // Owner of the root item and various other data (see data members).
 //
-class CDirStatDoc final : public CDocument
+class CDirStatDoc final : public CDocument, public CScanObserver
 {
 public:
     static CDirStatDoc* GetDocument();
@@ -97,16 +88,18 @@ protected:
     void SetPathName(LPCWSTR lpszPathName, BOOL bAddToMRU) override;
     void SetTitlePrefix(const std::wstring& prefix) const;
 
-    COLORREF GetCushionColor(const std::wstring& ext);
+    COLORREF GetCushionColor(CExtensionTable::Id ext);
     COLORREF GetZoomColor();
 
     const CExtensionData* GetExtensionData();
+    void RefreshExtensionData();
     ULONGLONG GetRootSize() const;
 
     static bool IsDrive(const std::wstring& spec);
     void RefreshReparsePointItems();
 
     bool HasRootItem() const;
+    bool IsOffline() const; // Tree was loaded from a volume image, so its paths do not exist
     bool IsRootDone() const;
     CItem* GetRootItem() const;
     CItem* GetZoomItem() const;
@@ -122,16 +115,29 @@ protected:
     void StopScanningEngine();
     void RefreshItem(const std::vector<CItem*>& item);
     void RefreshItem(CItem* item) { RefreshItem(std::vector{ item }); }
+    void StartWatchingForChanges();
+    void RefreshWatchedChanges();
+    void RevalidateScanCache();
+    void PrioritizeScan(CItem* item, bool subtree);
+
+    // Forwards the changes of the scanning engine to the views
+    void OnChildAdded(CItem* parent, CItem* child) override;
+    void OnChildrenAdded(CItem* parent, const std::vector<CItem*>& children) override;
+    void OnChildRemoved(CItem* parent, CItem* child) override;
+    void OnRemovingAllChildren(CItem* parent) override;
+    void OnDuplicateCandidate(CItem* item, BlockingQueue<CItem*>* queue) override;
+    void OnDuplicateCandidateRemoved(CItem* item) override;
+    const CItem* GetPriorityItem() const override;
 
     static void OpenItem(const CItem* item, const std::wstring& verb = {});
 
     void RecurseRefreshReparsePoints(CItem* items);
     std::vector<CItem*> GetDriveItems() const;
+    std::vector<BlockingQueue<CItem*>*> GetScanQueues();
     void RefreshRecyclers() const;
     void RebuildExtensionData();
-    void SortExtensionData(std::vector<std::wstring>& sortedExtensions);
-    void SetExtensionColors(const std::vector<std::wstring>& sortedExtensions);
-    static CExtensionData* _pqsortExtensionData;
+    void SortExtensionData(std::vector<CExtensionTable::Id>& sortedExtensions) const;
+    void SetExtensionColors(const std::vector<CExtensionTable::Id>& sortedExtensions);
     bool DeletePhysicalItems(const std::vector<CItem*>& items, bool toTrashBin);
     void SetZoomItem(CItem* item);
     static void AskForConfirmation(USERDEFINEDCLEANUP* udc, const CItem* item);
@@ -168,14 +174,21 @@ protected:
 
     CList<CItem*, CItem*> m_ReselectChildStack; // Stack for the "Re-select Child"-Feature
 
-    std::unordered_map<std::wstring, BlockingQueue<CItem*>> m_queues; // The scanning and thread queue
+    std::unordered_map<std::wstring, BlockingQueue<CItem*>> m_queues; // The scanning and thread queue; owned by the wrapper thread
+    std::mutex m_ScanQueuesMutex;
+    std::vector<std::pair<const CItem*, BlockingQueue<CItem*>*>> m_ScanQueues; // Queue of each scanned item once all of them run
+    bool m_ScanStopping = false; // Set by OnScanStop so queues published afterwards are cancelled right away
     std::thread* m_thread = nullptr; // Wrapper thread so we do not occupy the UI thread
+    std::vector<std::pair<CItem*, std::unique_ptr<DirectoryWatcher>>> m_Watchers; // Change notifications per scanned root
+    bool m_RevalidateScanCache = false; // Set once a scan served from the cache has been shown
 
     DECLARE_MESSAGE_MAP()
     afx_msg void OnRefreshSelected();
     afx_msg void OnRefreshAll();
     afx_msg void OnSaveResults();
+    afx_msg void OnSaveSlowestFolders();
     afx_msg void OnLoadResults();
+    afx_msg void OnLoadMft();
     afx_msg void OnEditCopy();
     afx_msg void OnCleanupEmptyRecycleBin();
     afx_msg void OnUpdateCentralHandler(CCmdUI* pCmdUI);
@@ -0,0 +1,137 @@
+// DirectoryWatcher.cpp - Implementation of DirectoryWatcher
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "DirectoryWatcher.h"
+#include "FileFind.h"
+#include <common/SmartPointer.h>
+
+#include <array>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    //
+    // DirectoryWatcherWin32. Keeps one overlapped ReadDirectoryChangesW request
+    // outstanding on the root for the whole subtree and records the parent
+    // folder of every entry that was added, removed, renamed or modified.
+    //
+    class DirectoryWatcherWin32 final : public DirectoryWatcher
+    {
+        static constexpr DWORD BUFFER_SIZE = 64 * 1024; // Largest size supported over the network
+
+        SmartPointer<HANDLE> m_Directory;
+        SmartPointer<HANDLE> m_Stop;
+        std::thread m_Thread;
+        std::mutex m_Mutex;
+        std::unordered_set<std::wstring> m_Changed;
+        bool m_Overflow = false;
+
+        void Run()
+        {
+            std::vector<DWORD> buffer(BUFFER_SIZE / sizeof(DWORD));
+            SmartPointer<HANDLE> event(CloseHandle, CreateEvent(nullptr, TRUE, FALSE, nullptr));
+            if (event == nullptr) return;
+
+            for (;;)
+            {
+                OVERLAPPED overlapped = {};
+                overlapped.hEvent = event;
+                if (!ReadDirectoryChangesW(m_Directory, buffer.data(), BUFFER_SIZE, TRUE,
+                    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES |
+                    FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &overlapped, nullptr))
+                {
+                    return;
+                }
+
+                // Wait for either a notification or shutdown
+                DWORD bytes = 0;
+                const std::array<HANDLE, 2> handles = { m_Stop, event };
+                if (WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+                {
+                    CancelIoEx(m_Directory, &overlapped);
+                    GetOverlappedResult(m_Directory, &overlapped, &bytes, TRUE);
+                    return;
+                }
+
+                const bool success = GetOverlappedResult(m_Directory, &overlapped, &bytes, FALSE) != 0;
+                const DWORD error = success ? ERROR_SUCCESS : GetLastError();
+
+                std::lock_guard lock(m_Mutex);
+                if (!success || bytes == 0)
+                {
+                    // The buffer overflowed or the root itself went away
+                    m_Overflow = true;
+                    if (error != ERROR_SUCCESS && error != ERROR_NOTIFY_ENUM_DIR) return;
+                    continue;
+                }
+
+                for (auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer.data());;
+                    info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(&reinterpret_cast<const BYTE*>(info)[info->NextEntryOffset]))
+                {
+                    const std::wstring_view name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                    const auto slash = name.rfind(L'\\');
+                    m_Changed.emplace(slash == std::wstring_view::npos ? std::wstring_view() : name.substr(0, slash));
+                    if (info->NextEntryOffset == 0) break;
+                }
+            }
+        }
+
+    public:
+        explicit DirectoryWatcherWin32(const std::wstring& root) :
+            m_Directory(CloseHandle, CreateFile(FileFindEnhanced::MakeLongPathCompatible(root).c_str(), FILE_LIST_DIRECTORY,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr)),
+            m_Stop(CloseHandle, CreateEvent(nullptr, TRUE, FALSE, nullptr))
+        {
+            if (m_Directory == INVALID_HANDLE_VALUE)
+            {
+                *m_Directory = nullptr;
+                return;
+            }
+
+            if (m_Stop != nullptr) m_Thread = std::thread(&DirectoryWatcherWin32::Run, this);
+        }
+
+        ~DirectoryWatcherWin32() override
+        {
+            if (m_Thread.joinable())
+            {
+                SetEvent(m_Stop);
+                m_Thread.join();
+            }
+        }
+
+        std::unordered_set<std::wstring> TakeChangedFolders(bool& overflow) override
+        {
+            std::lock_guard lock(m_Mutex);
+            overflow = m_Overflow;
+            m_Overflow = false;
+            return std::exchange(m_Changed, {});
+        }
+    };
+}
+
+std::unique_ptr<DirectoryWatcher> DirectoryWatcher::Create(const std::wstring& root)
+{
+    return std::make_unique<DirectoryWatcherWin32>(root);
+}
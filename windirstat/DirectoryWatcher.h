@@ -0,0 +1,42 @@
+// DirectoryWatcher.h - Declaration of DirectoryWatcher
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+//
+// DirectoryWatcher. Interface to the platform change notifications for one
+// scanned root. Changes are accumulated per folder so that only the folders
+// whose entries changed have to be enumerated again.
+//
+class DirectoryWatcher
+{
+public:
+    virtual ~DirectoryWatcher() = default;
+
+    // Returns the folders (relative to the root, empty for the root itself) that changed
+    // since the last call; overflow is set if events were lost and the root must be rescanned
+    virtual std::unordered_set<std::wstring> TakeChangedFolders(bool& overflow) = 0;
+
+    static std::unique_ptr<DirectoryWatcher> Create(const std::wstring& root);
+};
@@ -214,9 +214,13 @@ void CExtensionListControl::SetExtensionData(const CExtensionData* ed)
 {
     DeleteAllItems();
 
-    for (int i = 0; const auto & ext : *ed)
+    int i = 0;
+    for (CExtensionTable::Id ext = 0; ext < ed->size(); ext++)
     {
-        const auto item = new CListItem(this, ext.first, ext.second);
+        // Extensions that only occur outside of the current tree have no files
+        if ((*ed)[ext].files == 0) continue;
+
+        const auto item = new CListItem(this, CExtensionTable::Get()->GetName(ext), (*ed)[ext]);
         InsertListItem(i++, item);
     }
 
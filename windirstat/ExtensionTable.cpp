@@ -0,0 +1,124 @@
+// ExtensionTable.cpp - Implementation of CExtensionTable
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#include "stdafx.h"
+#include "ExtensionTable.h"
+
+#include <algorithm>
+#include <mutex>
+
+CExtensionTable* CExtensionTable::Get()
+{
+    static CExtensionTable table;
+    return &table;
+}
+
+CExtensionTable::Id CExtensionTable::Intern(const std::wstring_view extension)
+{
+    if (extension.empty()) return NoExtension;
+
+    thread_local std::wstring lower;
+    lower.assign(extension);
+    _wcslwr_s(lower.data(), lower.size() + 1);
+
+    SHARD& shard = m_Shards[Hash{}(lower) % m_Shards.size()];
+    {
+        std::shared_lock lock(shard.Mutex);
+        if (const auto id = shard.Ids.find(std::wstring_view(lower)); id != shard.Ids.end()) return id->second;
+    }
+
+    std::lock_guard lock(shard.Mutex);
+    if (const auto id = shard.Ids.find(std::wstring_view(lower)); id != shard.Ids.end()) return id->second;
+
+    Id id;
+    {
+        std::lock_guard namesLock(m_NamesMutex);
+        id = static_cast<Id>(m_Names.size());
+        m_Names.emplace_back(lower);
+    }
+    shard.Ids.emplace(lower, id);
+    return id;
+}
+
+std::wstring CExtensionTable::GetName(const Id id)
+{
+    std::shared_lock lock(m_NamesMutex);
+    return id < m_Names.size() ? m_Names[id] : std::wstring();
+}
+
+CExtensionTable::Id CExtensionTable::GetCount()
+{
+    std::shared_lock lock(m_NamesMutex);
+    return static_cast<Id>(m_Names.size());
+}
+
+CExtensionStatistics::SHARD* CExtensionStatistics::GetShard()
+{
+    // Threads only remember the instance they counted for last; the pointer
+    // is only used while the identifier still matches a live instance
+    thread_local std::pair<ULONGLONG, SHARD*> last;
+    if (last.first == m_Id) return last.second;
+
+    // Threads that switch between trees find their shard again by thread
+    const DWORD thread = GetCurrentThreadId();
+    std::lock_guard lock(m_Mutex);
+    const auto found = std::ranges::find(m_Shards, thread, [](const auto& shard) { return shard->Thread; });
+    SHARD* shard = found != m_Shards.end() ? found->get() :
+        m_Shards.emplace_back(std::make_unique<SHARD>(thread)).get();
+    last = { m_Id, shard };
+    return shard;
+}
+
+void CExtensionStatistics::Add(const CExtensionTable::Id ext, const LONGLONG bytes, const LONGLONG files)
+{
+    SHARD* shard = GetShard();
+    std::lock_guard lock(shard->Mutex);
+    if (ext >= shard->Counts.size()) shard->Counts.resize(ext + 1);
+    shard->Counts[ext].Bytes += bytes;
+    shard->Counts[ext].Files += files;
+}
+
+void CExtensionStatistics::Collect(CExtensionData* ed)
+{
+    // Files may be counted on one thread and removed on another, so
+    // only the sum over all shards is meaningful
+    std::vector<DELTA> totals;
+    {
+        std::lock_guard lock(m_Mutex);
+        for (const auto& shard : m_Shards)
+        {
+            std::lock_guard shardLock(shard->Mutex);
+            if (totals.size() < shard->Counts.size()) totals.resize(shard->Counts.size());
+            for (size_t ext = 0; ext < shard->Counts.size(); ext++)
+            {
+                totals[ext].Bytes += shard->Counts[ext].Bytes;
+                totals[ext].Files += shard->Counts[ext].Files;
+            }
+        }
+    }
+
+    if (ed->size() < totals.size()) ed->resize(totals.size());
+    for (size_t ext = 0; ext < totals.size(); ext++)
+    {
+        (*ed)[ext].bytes += static_cast<ULONGLONG>(std::max(totals[ext].Bytes, 0ll));
+        (*ed)[ext].files += static_cast<ULONGLONG>(std::max(totals[ext].Files, 0ll));
+    }
+}
@@ -0,0 +1,133 @@
+// ExtensionTable.h - Declaration of CExtensionTable
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//
+// CExtensionTable. Interns the lower case file extensions so items only
+// store a small identifier and extension statistics can be kept in arrays
+// indexed by it. The table is split into shards that are looked up under a
+// shared lock, so scanning threads only contend when they add a new
+// extension. Identifier 0 stands for files without an extension.
+//
+class CExtensionTable final
+{
+public:
+    using Id = ULONG;
+    static constexpr Id NoExtension = 0;
+
+    CExtensionTable(const CExtensionTable&) = delete;
+    CExtensionTable& operator=(const CExtensionTable&) = delete;
+
+    static CExtensionTable* Get();
+
+    // Extensions include the dot and are compared without regard to case
+    Id Intern(std::wstring_view extension);
+    std::wstring GetName(Id id);
+
+    // All identifiers handed out so far are below this
+    Id GetCount();
+
+private:
+    CExtensionTable() = default;
+
+    struct Hash
+    {
+        using is_transparent = void;
+        size_t operator()(const std::wstring_view s) const { return std::hash<std::wstring_view>{}(s); }
+    };
+
+    struct SHARD
+    {
+        std::shared_mutex Mutex;
+        std::unordered_map<std::wstring, Id, Hash, std::equal_to<>> Ids;
+    };
+
+    std::array<SHARD, 64> m_Shards;
+    std::shared_mutex m_NamesMutex;
+    std::vector<std::wstring> m_Names = std::vector<std::wstring>(1); // Indexed by identifier
+};
+
+//
+// Data stored for each extension.
+//
+struct SExtensionRecord
+{
+    ULONGLONG files = 0;
+    ULONGLONG bytes = 0;
+    COLORREF color = 0;
+};
+
+//
+// SExtensionRecords indexed by the CExtensionTable identifier of the extension.
+// Extensions without files in the tree have a record with no files.
+//
+using CExtensionData = std::vector<SExtensionRecord>;
+
+//
+// CExtensionStatistics. File and byte counts per extension of one tree that
+// are kept up to date while files are added, resized and deleted. Each thread
+// counts into a shard of its own which Collect() merges on demand, so the
+// cost of reading them depends on the number of extensions, not of files.
+//
+class CExtensionStatistics final
+{
+public:
+    CExtensionStatistics() = default;
+    CExtensionStatistics(const CExtensionStatistics&) = delete;
+    CExtensionStatistics& operator=(const CExtensionStatistics&) = delete;
+
+    void Add(CExtensionTable::Id ext, LONGLONG bytes, LONGLONG files);
+    void Collect(CExtensionData* ed);
+
+private:
+    struct DELTA
+    {
+        LONGLONG Bytes = 0;
+        LONGLONG Files = 0;
+    };
+
+    struct SHARD
+    {
+        explicit SHARD(const DWORD thread) : Thread(thread) {}
+        const DWORD Thread; // Counting thread
+        std::mutex Mutex;   // Only contended while collecting
+        std::vector<DELTA> Counts;
+    };
+
+    SHARD* GetShard();
+
+    static inline std::atomic<ULONGLONG> m_NextId = 1;
+    const ULONGLONG m_Id = m_NextId++; // Distinguishes instances that reuse an address
+    std::mutex m_Mutex;
+    std::vector<std::unique_ptr<SHARD>> m_Shards;
+};
@@ -109,7 +109,7 @@ void CFileDupeControl::ProcessDuplicate(CItem * item, BlockingQueue<CItem*>* que
 {
     if (!COptions::ScanForDuplicates) return;
     if (COptions::SkipDupeDetectionCloudLinks.Obj() &&
-        CDirStatApp::Get()->GetReparseInfo()->IsCloudLink(item->GetPathLong(), item->GetAttributes())) return;
+        CReparsePoints::IsCloudLink(item->GetAttributes(), item->GetReparseTag())) return;
 
     std::unique_lock lock(m_Mutex);
     const auto sizeEntry = m_SizeTracker.find(item->GetSizeLogical());
@@ -194,6 +194,9 @@ void CFileDupeControl::ProcessDuplicate(CItem * item, BlockingQueue<CItem*>* que
 
 void CFileDupeControl::RemoveItem(CItem* item)
 {
+    // Refreshes that merge in place remove items from the scanning threads
+    std::unique_lock lock(m_Mutex);
+
     // Exit immediately if not doing duplicate detector
     if (m_HashTracker.empty() && m_SizeTracker.empty()) return;
 
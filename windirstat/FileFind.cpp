@@ -23,6 +23,8 @@
 #include <winternl.h>
 
 #include "FileFind.h"
+#include "MountPoints.h"
+#include "ScanStatistics.h"
 #include "Options.h"
 #include <common/Tracer.h>
 
@@ -34,55 +36,307 @@ NTSTATUS(WINAPI* NtQueryDirectoryFile)(HANDLE FileHandle, HANDLE Event, PVOID Ap
     PUNICODE_STRING FileName, BOOLEAN RestartScan) = reinterpret_cast<decltype(NtQueryDirectoryFile)>(
         static_cast<LPVOID>(GetProcAddress(LoadLibrary(L"ntdll.dll"), "NtQueryDirectoryFile")));
 
-FileFindEnhanced::~FileFindEnhanced()
+namespace
 {
-    if (m_Handle != nullptr) NtClose(m_Handle);
+    //
+    // FileFindBackendNt. Enumerates a directory with NtQueryDirectoryFile, which
+    // returns many entries per call including sizes and the file id so no
+    // additional per-file queries are needed. Unless disabled, the handle is
+    // opened for overlapped I/O and the next batch is requested while the caller
+    // is still processing the current one, hiding the round trip on network and
+    // spinning volumes. Otherwise each batch is queried synchronously on demand.
+    //
+    class FileFindBackendNt final : public FileFindBackend
+    {
+        using FILE_ID_FULL_DIR_INFORMATION = struct {
+            ULONG         NextEntryOffset;
+            ULONG         FileIndex;
+            LARGE_INTEGER CreationTime;
+            LARGE_INTEGER LastAccessTime;
+            LARGE_INTEGER LastWriteTime;
+            LARGE_INTEGER ChangeTime;
+            LARGE_INTEGER EndOfFile;
+            LARGE_INTEGER AllocationSize;
+            ULONG         FileAttributes;
+            ULONG         FileNameLength;
+            ULONG         EaSize;
+            LARGE_INTEGER FileId;
+            WCHAR         FileName[1];
+        };
+
+        static constexpr auto BUFFER_SIZE = 256 * 1024;
+
+        // One buffer is decoded while the other is being filled
+        struct BufferSet
+        {
+            std::vector<BYTE> Data[2] = { std::vector<BYTE>(BUFFER_SIZE), std::vector<BYTE>(BUFFER_SIZE) };
+            HANDLE Event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+            ~BufferSet() { if (Event != nullptr) CloseHandle(Event); }
+        };
+
+        // Buffers are pooled per thread so nested enumerations (e.g. recursive
+        // cleanups) each get their own while sequential ones reuse the same memory
+        static std::vector<std::unique_ptr<BufferSet>>& BufferPool()
+        {
+            thread_local std::vector<std::unique_ptr<BufferSet>> pool;
+            return pool;
+        }
+
+        DirectoryHandle m_Directory;
+        HANDLE m_Handle = nullptr;
+        std::unique_ptr<BufferSet> m_Buffers;
+        UNICODE_STRING m_Search = {};
+        IO_STATUS_BLOCK m_IoStatus = {};
+        NTSTATUS m_Status = 0;
+        int m_Current = 0;
+        bool m_Outstanding = false;
+        bool m_ReadAhead = false;
+
+        void Issue(const std::wstring& pattern, const bool restart)
+        {
+            // handle optional pattern mask; only consulted on the initial query
+            m_Search.Length = static_cast<USHORT>(pattern.size() * sizeof(WCHAR));
+            m_Search.MaximumLength = static_cast<USHORT>(pattern.size() + 1) * sizeof(WCHAR);
+            m_Search.Buffer = const_cast<PWSTR>(pattern.data());
+
+            // enumerate files in the directory
+            constexpr auto FileIdFullDirectoryInformation = 38;
+            if (m_ReadAhead) ResetEvent(m_Buffers->Event);
+            m_Status = NtQueryDirectoryFile(m_Handle, m_ReadAhead ? m_Buffers->Event : nullptr, nullptr, nullptr,
+                &m_IoStatus, m_Buffers->Data[m_Current].data(), BUFFER_SIZE,
+                static_cast<FILE_INFORMATION_CLASS>(FileIdFullDirectoryInformation), FALSE,
+                (restart && m_Search.Length > 0) ? &m_Search : nullptr, restart ? TRUE : FALSE);
+            m_Outstanding = true;
+        }
+
+        NTSTATUS Complete()
+        {
+            if (m_Status == static_cast<NTSTATUS>(STATUS_PENDING))
+            {
+                WaitForSingleObject(m_Buffers->Event, INFINITE);
+                m_Status = m_IoStatus.Status;
+            }
+
+            m_Outstanding = false;
+            return m_Status;
+        }
+
+    public:
+        FileFindBackendNt()
+        {
+            auto& pool = BufferPool();
+            if (pool.empty()) m_Buffers = std::make_unique<BufferSet>();
+            else
+            {
+                m_Buffers = std::move(pool.back());
+                pool.pop_back();
+            }
+
+            m_ReadAhead = COptions::ScanningReadAhead && m_Buffers->Event != nullptr;
+        }
+
+        ~FileFindBackendNt() override
+        {
+            // the buffer cannot be reused while the read-ahead may still write to it
+            if (m_Outstanding && m_Status == static_cast<NTSTATUS>(STATUS_PENDING))
+            {
+                CancelIoEx(m_Handle, nullptr);
+                WaitForSingleObject(m_Buffers->Event, INFINITE);
+            }
+
+            BufferPool().emplace_back(std::move(m_Buffers));
+        }
+
+        bool Open(const std::wstring& path, const DirectoryHandle& parent) override
+        {
+            // relative to the parent only the final component has to be resolved
+            const auto slash = path.find_last_of(L'\\');
+            const std::wstring_view name = parent != nullptr && slash != std::wstring::npos ?
+                std::wstring_view(path).substr(slash + 1) : std::wstring_view(path);
+
+            UNICODE_STRING uPath;
+            uPath.Length = static_cast<USHORT>(name.size() * sizeof(WCHAR));
+            uPath.MaximumLength = static_cast<USHORT>(name.size() * sizeof(WCHAR));
+            uPath.Buffer = const_cast<PWSTR>(name.data());
+
+            // update object attributes object
+            OBJECT_ATTRIBUTES attributes;
+            InitializeObjectAttributes(&attributes, nullptr, OBJ_CASE_INSENSITIVE,
+                parent != nullptr ? parent.get() : nullptr, nullptr);
+            attributes.ObjectName = &uPath;
+
+            // get an open file handle
+            IO_STATUS_BLOCK statusBlock = {};
+            if (const NTSTATUS status = NtOpenFile(&m_Handle, FILE_LIST_DIRECTORY | FILE_TRAVERSE | SYNCHRONIZE,
+                &attributes, &statusBlock, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, FILE_DIRECTORY_FILE |
+                FILE_OPEN_FOR_BACKUP_INTENT | (m_ReadAhead ? 0 : FILE_SYNCHRONOUS_IO_NONALERT)); status != 0)
+            {
+                VTRACE(L"File Access Error {:#08X}: {}", static_cast<DWORD>(status), path.data());
+                m_Handle = nullptr;
+                return false;
+            }
+
+            m_Directory = DirectoryHandle(m_Handle, NtClose);
+            return true;
+        }
+
+        DirectoryHandle GetDirectoryHandle() const override
+        {
+            return m_Directory;
+        }
+
+        bool ReadBatch(const std::wstring& pattern, const bool restart, std::vector<FileFindEntry>& entries) override
+        {
+            entries.clear();
+
+            // the read-ahead has normally already been issued by the previous batch
+            if (restart || !m_Outstanding) Issue(pattern, restart);
+            if (Complete() != 0)
+            {
+                return false;
+            }
+
+            // decode the whole buffer at once
+            for (auto info = reinterpret_cast<FILE_ID_FULL_DIR_INFORMATION*>(m_Buffers->Data[m_Current].data());;
+                info = reinterpret_cast<FILE_ID_FULL_DIR_INFORMATION*>(&reinterpret_cast<BYTE*>(info)[info->NextEntryOffset]))
+            {
+                auto& entry = entries.emplace_back();
+                entry.Name = { info->FileName, info->FileNameLength / sizeof(WCHAR) };
+                entry.Attributes = info->FileAttributes;
+                entry.SizeLogical = info->EndOfFile.QuadPart;
+                entry.SizePhysical = info->AllocationSize.QuadPart;
+                entry.LastWriteTime = { info->LastWriteTime.LowPart, static_cast<DWORD>(info->LastWriteTime.HighPart) };
+                entry.FileId = info->FileId.QuadPart;
+
+                // for reparse points the extended attribute size holds the reparse tag instead
+                entry.ReparseTag = (info->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 ? info->EaSize : 0;
+                if (info->NextEntryOffset == 0) break;
+            }
+
+            // request the next batch into the other buffer while this one is consumed
+            if (m_ReadAhead)
+            {
+                m_Current ^= 1;
+                Issue(pattern, false);
+            }
+
+            return !entries.empty();
+        }
+
+        bool IsExhausted() const override
+        {
+            constexpr auto NoMoreFiles = static_cast<NTSTATUS>(0x80000006);
+            return !m_Outstanding && m_Status == NoMoreFiles;
+        }
+
+        bool GetIdentity(DWORD& volumeSerial, ULONGLONG& fileId, FILETIME& lastWrite) override
+        {
+            BY_HANDLE_FILE_INFORMATION info;
+            if (m_Handle == nullptr || GetFileInformationByHandle(m_Handle, &info) == 0) return false;
+
+            volumeSerial = info.dwVolumeSerialNumber;
+            fileId = static_cast<ULONGLONG>(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+            lastWrite = info.ftLastWriteTime;
+            return true;
+        }
+    };
+}
+
+std::unique_ptr<FileFindBackend> FileFindBackend::Create()
+{
+    return std::make_unique<FileFindBackendNt>();
+}
+
+DirectoryHandleCache* DirectoryHandleCache::Get()
+{
+    static DirectoryHandleCache cache;
+    return &cache;
+}
+
+void DirectoryHandleCache::Register(const void* owner, const DirectoryHandle& handle)
+{
+    if (handle == nullptr) return;
+
+    // A refreshed owner starts over with its new handle
+    std::lock_guard lock(m_Mutex);
+    if (m_Entries.size() < MAX_HANDLES || m_Entries.contains(owner)) m_Entries[owner] = { .Handle = handle };
+    m_Count = m_Entries.size();
+}
+
+void DirectoryHandleCache::Seal(const void* owner, const ULONG children)
+{
+    std::lock_guard lock(m_Mutex);
+    const auto entry = m_Entries.find(owner);
+    if (entry == m_Entries.end()) return;
+
+    // Subdirectories may already have been opened by other threads
+    entry->second.Expected = children;
+    entry->second.Sealed = true;
+    if (entry->second.Acquired >= children) m_Entries.erase(entry);
+    m_Count = m_Entries.size();
+}
+
+DirectoryHandle DirectoryHandleCache::Acquire(const void* owner)
+{
+    std::lock_guard lock(m_Mutex);
+    const auto entry = m_Entries.find(owner);
+    if (entry == m_Entries.end()) return {};
+
+    DirectoryHandle handle = entry->second.Handle;
+    if (++entry->second.Acquired >= entry->second.Expected && entry->second.Sealed) m_Entries.erase(entry);
+    m_Count = m_Entries.size();
+    return handle;
+}
+
+void DirectoryHandleCache::Forget(const void* owner)
+{
+    if (m_Count == 0) return;
+
+    std::lock_guard lock(m_Mutex);
+    m_Entries.erase(owner);
+    m_Count = m_Entries.size();
+}
+
+void DirectoryHandleCache::Clear()
+{
+    std::lock_guard lock(m_Mutex);
+    m_Entries.clear();
+    m_Count = 0;
 }
 
 bool FileFindEnhanced::FindNextFile()
 {
     bool success = false;
-    if (m_Firstrun || m_CurrentInfo->NextEntryOffset == 0)
+    if (m_Firstrun || m_EntryIndex + 1 >= m_Entries.size())
     {
-        constexpr auto BUFFER_SIZE = 64 * 1024;
-        thread_local std::vector<BYTE> m_DirectoryInfo(BUFFER_SIZE);
-
-        // handle optional pattern mask
-        UNICODE_STRING uSearch;
-        uSearch.Length = static_cast<USHORT>(m_Search.size() * sizeof(WCHAR));
-        uSearch.MaximumLength = static_cast<USHORT>(m_Search.size() + 1) * sizeof(WCHAR);
-        uSearch.Buffer = m_Search.data();
-
-        // enumerate files in the directory
-        constexpr auto FileDirectoryInformation = 1;
-        IO_STATUS_BLOCK IoStatusBlock;
-        const NTSTATUS Status = NtQueryDirectoryFile(m_Handle, nullptr, nullptr, nullptr, &IoStatusBlock,
-            m_DirectoryInfo.data(), BUFFER_SIZE, static_cast<FILE_INFORMATION_CLASS>(FileDirectoryInformation),
-            FALSE, (uSearch.Length > 0) ? &uSearch : nullptr, (m_Firstrun) ? TRUE : FALSE);
-
-        // fetch point to current node 
-        success = (Status == 0);
-        m_CurrentInfo = reinterpret_cast<FILE_DIRECTORY_INFORMATION*>(m_DirectoryInfo.data());
+        m_EntryIndex = 0;
+        const ULONGLONG start = CScanStatistics::Now();
+        success = m_Backend->ReadBatch(m_Search, m_Firstrun, m_Entries);
+        const ULONGLONG elapsed = CScanStatistics::Now() - start;
+        m_FileSystemTime += elapsed;
+        CScanStatistics::RecordEnumeration(elapsed);
     }
     else
     {
-        m_CurrentInfo = reinterpret_cast<FILE_DIRECTORY_INFORMATION*>(
-            &reinterpret_cast<BYTE*>(m_CurrentInfo)[m_CurrentInfo->NextEntryOffset]);
+        m_EntryIndex++;
         success = true;
     }
 
     if (success)
     {
         // copy name into local buffer
-        m_Name.resize(m_CurrentInfo->FileNameLength / sizeof(WCHAR));
-        memcpy(m_Name.data(), m_CurrentInfo->FileName, m_CurrentInfo->FileNameLength);
+        m_CurrentInfo = &m_Entries[m_EntryIndex];
+        m_Name = m_CurrentInfo->Name;
 
-        // special case for reparse on initial run points - update attributes
-        if (m_Firstrun)
+        // special case for reparse on initial run points - update attributes;
+        // the dots entries are skipped by every caller so spare the path lookup
+        if (m_Firstrun && !IsDots())
         {
-            std::wstring initialPath = GetFilePathLong();
-            if (IsDots()) initialPath.pop_back();
-            m_CurrentInfo->FileAttributes = GetFileAttributes(initialPath.c_str());
+            m_CurrentInfo->Attributes = GetFileAttributes(GetFilePathLong().c_str());
+            if (m_CurrentInfo->ReparseTag == 0 && CReparsePoints::IsReparsePoint(m_CurrentInfo->Attributes))
+            {
+                m_CurrentInfo->ReparseTag = CReparsePoints::GetReparseTag(GetFilePathLong());
+            }
         }
     }
 
@@ -91,31 +345,56 @@ bool FileFindEnhanced::FindNextFile()
 }
 
 bool FileFindEnhanced::FindFile(const std::wstring & strFolder, const std::wstring& strName)
+{
+    return FindFile(strFolder, strName, FileFindBackend::Create());
+}
+
+bool FileFindEnhanced::FindFile(const std::wstring& name, const DirectoryHandle& parent,
+    std::function<std::wstring()> resolveFolder, std::unique_ptr<FileFindBackend> backend)
+{
+    m_Search.clear();
+    m_Base.clear();
+    m_ResolveBase = std::move(resolveFolder);
+
+    m_Backend = std::move(backend);
+    const ULONGLONG start = CScanStatistics::Now();
+    bool opened = m_Backend->Open(name, parent);
+
+    // Cached parents may be renamed or deleted while open, so fall back to the path
+    if (!opened && parent != nullptr && m_ResolveBase != nullptr)
+    {
+        ResolveBase();
+        opened = m_Backend->Open(m_Base, nullptr);
+    }
+    m_FileSystemTime = CScanStatistics::Now() - start;
+    CScanStatistics::RecordEnumeration(m_FileSystemTime);
+    if (!opened)
+    {
+        return FALSE;
+    }
+
+    return FindNextFile();
+}
+
+bool FileFindEnhanced::FindFile(const std::wstring& strFolder, const std::wstring& strName, std::unique_ptr<FileFindBackend> backend, const DirectoryHandle& parent)
 {
     // stash the search pattern for later use
     m_Search = strName;
+    m_ResolveBase = nullptr;
 
     // convert the path to a long path that is compatible with the other call
     m_Base = strFolder;
     if (m_Base.find(L":\\", 1) == 1) m_Base = m_Dos + m_Base;
     else if (m_Base.starts_with(L"\\\\")) m_Base = m_DosUNC + m_Base.substr(2);
-    UNICODE_STRING path;
-    path.Length = static_cast<USHORT>(m_Base.size() * sizeof(WCHAR));
-    path.MaximumLength = static_cast<USHORT>(m_Base.size() + 1) * sizeof(WCHAR);
-    path.Buffer = m_Base.data();
-
-    // update object attributes object
-    OBJECT_ATTRIBUTES attributes;
-    InitializeObjectAttributes(&attributes, nullptr, OBJ_CASE_INSENSITIVE, nullptr, nullptr);
-    attributes.ObjectName = &path;
-
-    // get an open file handle
-    IO_STATUS_BLOCK statusBlock = {};
-    if (const NTSTATUS status = NtOpenFile(&m_Handle, FILE_LIST_DIRECTORY | SYNCHRONIZE,
-        &attributes, &statusBlock, FILE_SHARE_READ | FILE_SHARE_WRITE, 
-        FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT); status != 0)
+
+    // open the directory with the enumeration backend
+    m_Backend = std::move(backend);
+    const ULONGLONG start = CScanStatistics::Now();
+    const bool opened = m_Backend->Open(m_Base, parent);
+    m_FileSystemTime = CScanStatistics::Now() - start;
+    CScanStatistics::RecordEnumeration(m_FileSystemTime);
+    if (!opened)
     {
-        VTRACE(L"File Access Error {:#08X}: {}", static_cast<DWORD>(status), m_Base.data());
         return FALSE;
     }
 
@@ -123,9 +402,19 @@ bool FileFindEnhanced::FindFile(const std::wstring & strFolder, const std::wstri
     return FindNextFile();
 }
 
+ULONGLONG FileFindEnhanced::GetFileSystemTime() const
+{
+    return m_FileSystemTime;
+}
+
+DirectoryHandle FileFindEnhanced::GetDirectoryHandle() const
+{
+    return m_Backend != nullptr ? m_Backend->GetDirectoryHandle() : DirectoryHandle();
+}
+
 bool FileFindEnhanced::IsDirectory() const
 {
-    return (m_CurrentInfo->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    return (m_CurrentInfo->Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
 }
 
 bool FileFindEnhanced::IsDots() const
@@ -135,24 +424,24 @@ bool FileFindEnhanced::IsDots() const
 
 bool FileFindEnhanced::IsHidden() const
 {
-    return (m_CurrentInfo->FileAttributes & FILE_ATTRIBUTE_HIDDEN) != 0;
+    return (m_CurrentInfo->Attributes & FILE_ATTRIBUTE_HIDDEN) != 0;
 }
 
 bool FileFindEnhanced::IsHiddenSystem() const
 {
     constexpr DWORD hiddenSystem = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM;
-    return (m_CurrentInfo->FileAttributes & hiddenSystem) == hiddenSystem;
+    return (m_CurrentInfo->Attributes & hiddenSystem) == hiddenSystem;
 }
 
 bool FileFindEnhanced::IsProtectedReparsePoint() const
 {
     constexpr DWORD protect = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_REPARSE_POINT;
-    return (m_CurrentInfo->FileAttributes & protect) == protect;
+    return (m_CurrentInfo->Attributes & protect) == protect;
 }
 
 DWORD FileFindEnhanced::GetAttributes() const
 {
-    return m_CurrentInfo->FileAttributes;
+    return m_CurrentInfo->Attributes;
 }
 
 std::wstring FileFindEnhanced::GetFileName() const
@@ -162,29 +451,52 @@ std::wstring FileFindEnhanced::GetFileName() const
 
 ULONGLONG FileFindEnhanced::GetFileSizePhysical() const
 {
-    if (m_CurrentInfo->AllocationSize.QuadPart == 0 &&
-        m_CurrentInfo->EndOfFile.QuadPart != 0)
+    if (m_CurrentInfo->SizePhysical == 0 &&
+        m_CurrentInfo->SizeLogical != 0)
     {
-        m_CurrentInfo->AllocationSize.LowPart  = GetCompressedFileSize(GetFilePathLong().c_str(),
-            reinterpret_cast<LPDWORD>(&m_CurrentInfo->AllocationSize.HighPart));
+        ULARGE_INTEGER size;
+        size.LowPart = GetCompressedFileSize(GetFilePathLong().c_str(), &size.HighPart);
+        m_CurrentInfo->SizePhysical = size.QuadPart;
     }
 
-    return m_CurrentInfo->AllocationSize.QuadPart;
+    return m_CurrentInfo->SizePhysical;
 }
 
 ULONGLONG FileFindEnhanced::GetFileSizeLogical() const
 {
-    return m_CurrentInfo->EndOfFile.QuadPart;
+    return m_CurrentInfo->SizeLogical;
 }
 
 FILETIME FileFindEnhanced::GetLastWriteTime() const
 {
-    return { m_CurrentInfo->LastWriteTime.LowPart,
-        static_cast<DWORD>(m_CurrentInfo->LastWriteTime.HighPart) };
+    return m_CurrentInfo->LastWriteTime;
+}
+
+ULONGLONG FileFindEnhanced::GetFileId() const
+{
+    return m_CurrentInfo->FileId;
+}
+
+DWORD FileFindEnhanced::GetReparseTag() const
+{
+    return m_CurrentInfo->ReparseTag;
+}
+
+void FileFindEnhanced::ResolveBase() const
+{
+    // Folders opened relative to their parent only know their full path on request
+    if (m_Base.empty() && m_ResolveBase != nullptr)
+    {
+        m_Base = m_ResolveBase();
+        if (m_Base.find(L":\\", 1) == 1) m_Base = m_Dos + m_Base;
+        else if (m_Base.starts_with(L"\\\\")) m_Base = m_DosUNC + m_Base.substr(2);
+    }
 }
 
 std::wstring FileFindEnhanced::GetFilePath() const
 {
+    ResolveBase();
+
     // Get full path to folder or file
     std::wstring path = (m_Base.at(m_Base.size() - 1) == L'\\') ?
         (m_Base + m_Name) : (m_Base + L"\\" + m_Name);
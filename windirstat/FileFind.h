@@ -22,42 +22,131 @@
 #pragma once
 
 #include <stdafx.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <string_view>
+#include <vector>
 
-class FileFindEnhanced final
+//
+// FileFindEntry. One directory entry as produced by an enumeration backend.
+// The name refers into the backend buffer and is only valid until the next batch.
+//
+struct FileFindEntry
+{
+    std::wstring_view Name;
+    DWORD Attributes = 0;
+    ULONGLONG SizeLogical = 0;
+    ULONGLONG SizePhysical = 0;
+    FILETIME LastWriteTime = { 0, 0 };
+    ULONGLONG FileId = 0;
+    DWORD ReparseTag = 0; // Only set for reparse points
+};
+
+// An open directory that children can be opened relative to
+using DirectoryHandle = std::shared_ptr<void>;
+
+//
+// FileFindBackend. Interface to the platform directory enumeration. A backend
+// opens a directory and then returns its entries in batches that are decoded
+// from one large buffer that is reused for every directory on a thread.
+//
+class FileFindBackend
 {
-    using FILE_DIRECTORY_INFORMATION = struct {
-        ULONG         NextEntryOffset;
-        ULONG         FileIndex;
-        LARGE_INTEGER CreationTime;
-        LARGE_INTEGER LastAccessTime;
-        LARGE_INTEGER LastWriteTime;
-        LARGE_INTEGER ChangeTime;
-        LARGE_INTEGER EndOfFile;
-        LARGE_INTEGER AllocationSize;
-        ULONG         FileAttributes;
-        ULONG         FileNameLength;
-        WCHAR         FileName[1];
+public:
+    virtual ~FileFindBackend() = default;
+    // With a parent handle only the last component of the path is resolved
+    virtual bool Open(const std::wstring& path, const DirectoryHandle& parent = {}) = 0;
+    virtual bool ReadBatch(const std::wstring& pattern, bool restart, std::vector<FileFindEntry>& entries) = 0;
+
+    // Identifies the open directory across runs; false if not supported
+    virtual bool GetIdentity(DWORD& /*volumeSerial*/, ULONGLONG& /*fileId*/, FILETIME& /*lastWrite*/) { return false; }
+
+    // True once ReadBatch() returned false because all entries were read, not due to an error
+    virtual bool IsExhausted() const { return false; }
+
+    // The open directory for relative opens of its subdirectories; empty if not supported
+    virtual DirectoryHandle GetDirectoryHandle() const { return {}; }
+
+    static std::unique_ptr<FileFindBackend> Create();
+};
+
+//
+// DirectoryHandleCache. Keeps the handle of a scanned directory open until all of
+// its queued subdirectories have been opened relative to it. The number of
+// retained handles is bounded; directories beyond that are opened by full path.
+// Owners are addresses of items which may be reused, so items forget their
+// entry when they are destroyed.
+//
+class DirectoryHandleCache final
+{
+    static constexpr std::size_t MAX_HANDLES = 4096;
+
+    struct Entry
+    {
+        DirectoryHandle Handle;
+        ULONG Acquired = 0;
+        ULONG Expected = 0;
+        bool Sealed = false;
     };
 
+    std::mutex m_Mutex;
+    std::unordered_map<const void*, Entry> m_Entries;
+    std::atomic<std::size_t> m_Count = 0; // Spares the lock when nothing is cached
+
+public:
+    static DirectoryHandleCache* Get();
+
+    // Called once the owner is open and before its subdirectories are queued
+    void Register(const void* owner, const DirectoryHandle& handle);
+
+    // Called once the owner queued all its subdirectories
+    void Seal(const void* owner, ULONG children);
+
+    // Called by each subdirectory of the owner before opening it
+    DirectoryHandle Acquire(const void* owner);
+
+    // Called when the owner is destroyed
+    void Forget(const void* owner);
+
+    void Clear();
+};
+
+class FileFindEnhanced final
+{
+    std::unique_ptr<FileFindBackend> m_Backend;
+    std::vector<FileFindEntry> m_Entries;
+    std::size_t m_EntryIndex = 0;
     std::wstring m_Search;
-    std::wstring m_Base;
+    mutable std::wstring m_Base;
+    std::function<std::wstring()> m_ResolveBase; // Builds m_Base on demand for relative opens
     std::wstring m_Name;
-    HANDLE m_Handle = nullptr;
     bool m_Firstrun = true;
-    FILE_DIRECTORY_INFORMATION* m_CurrentInfo = nullptr;
+    ULONGLONG m_FileSystemTime = 0;
+    FileFindEntry* m_CurrentInfo = nullptr;
     static constexpr auto m_Dos = L"\\??\\";
     static constexpr auto m_DosUNC = L"\\??\\UNC\\";
     static constexpr auto m_Long = L"\\\\?\\";
     static constexpr auto m_LongUNC = L"\\\\?\\UNC\\";
 
+    void ResolveBase() const;
+
 public:
 
     FileFindEnhanced() = default;
-    ~FileFindEnhanced();
+    ~FileFindEnhanced() = default;
 
     bool FindNextFile();
     bool FindFile(const std::wstring& strFolder,const std::wstring& strName = L"");
+    bool FindFile(const std::wstring& strFolder, const std::wstring& strName, std::unique_ptr<FileFindBackend> backend, const DirectoryHandle& parent = {});
+
+    // Opens the named subdirectory of the open parent; the full path is only built if an entry needs it
+    bool FindFile(const std::wstring& name, const DirectoryHandle& parent, std::function<std::wstring()> resolveFolder, std::unique_ptr<FileFindBackend> backend);
+    DirectoryHandle GetDirectoryHandle() const;
+    ULONGLONG GetFileSystemTime() const; // Microseconds spent opening and reading the directory
     bool IsDirectory() const;
     bool IsDots() const;
     bool IsHidden() const;
@@ -68,6 +157,8 @@ public:
     ULONGLONG GetFileSizePhysical() const;
     ULONGLONG GetFileSizeLogical() const;
     FILETIME GetLastWriteTime() const;
+    ULONGLONG GetFileId() const;
+    DWORD GetReparseTag() const;
     std::wstring GetFilePath() const;
     std::wstring GetFilePathLong() const;
     static bool DoesFileExist(const std::wstring& folder, const std::wstring& file = {});
@@ -117,6 +117,12 @@ void CFileTreeControl::OnItemDoubleClick(const int i)
     }
 }
 
+void CFileTreeControl::OnItemExpanded(CTreeListItem* item)
+{
+    // Unfinished folders that just became visible are scanned next
+    CDirStatDoc::GetDocument()->PrioritizeScan(reinterpret_cast<CItem*>(item), false);
+}
+
 void CFileTreeControl::PrepareDefaultMenu(CMenu* menu, const CItem* item)
 {
     if (item->TmiIsLeaf())
@@ -36,6 +36,7 @@ protected:
     static CFileTreeControl * m_Singleton;
 
     void OnItemDoubleClick(int i) override;
+    void OnItemExpanded(CTreeListItem* item) override;
     void PrepareDefaultMenu(CMenu* menu, const CItem* item);
 
     DECLARE_MESSAGE_MAP()
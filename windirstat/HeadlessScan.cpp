@@ -0,0 +1,206 @@
+// HeadlessScan.cpp - Implementation of CHeadlessScan
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "HeadlessScan.h"
+#include "CsvLoader.h"
+#include "GlobalHelpers.h"
+#include "Item.h"
+#include "Localization.h"
+#include "Options.h"
+#include "ScanCache.h"
+#include "ScanStatistics.h"
+#include "WinDirStat.h"
+#include <common/Constants.h>
+
+#include <array>
+#include <format>
+#include <memory>
+#include <ranges>
+#include <unordered_map>
+
+namespace
+{
+    bool IsDriveRoot(const std::wstring& path)
+    {
+        return path.size() == 3 && path[1] == wds::chrColon && path[2] == wds::chrBackslash;
+    }
+}
+
+bool CHeadlessScan::IsRequested()
+{
+    return __argc > 1 && (_wcsicmp(__wargv[1], L"/scan") == 0 || _wcsicmp(__wargv[1], L"-scan") == 0);
+}
+
+bool CHeadlessScan::ParseArguments()
+{
+    m_Threads = COptions::ScanningThreads;
+    for (int i = 2; i < __argc; i++)
+    {
+        const std::wstring arg = __wargv[i];
+        const bool hasValue = i + 1 < __argc;
+        if (_wcsicmp(arg.c_str(), L"/out") == 0 && hasValue) m_OutputFile = __wargv[++i];
+        else if (_wcsicmp(arg.c_str(), L"/stats") == 0 && hasValue) m_StatisticsFile = __wargv[++i];
+        else if (_wcsicmp(arg.c_str(), L"/threads") == 0 && hasValue) m_Threads = wcstoul(__wargv[++i], nullptr, 10);
+        else if (arg.starts_with(L'/') && arg.size() > 2) return false;
+        else
+        {
+            // Drives are addressed by their root folder and folders without a trailing backslash
+            std::wstring root = arg;
+            if (root.size() == 2 && root[1] == wds::chrColon) root += wds::chrBackslash;
+            while (root.size() > 3 && root.back() == wds::chrBackslash) root.pop_back();
+            m_Roots.emplace_back(root);
+        }
+    }
+
+    return !m_Roots.empty() && m_Threads > 0;
+}
+
+CItem* CHeadlessScan::CreateRootItem() const
+{
+    // Several roots are gathered under a single node like selected drives in the GUI
+    if (m_Roots.size() > 1)
+    {
+        const auto root = ::new CItem(IT_MYCOMPUTER | ITF_ROOTITEM, Localization::Lookup(IDS_MYCOMPUTER));
+        for (const auto& path : m_Roots)
+        {
+            root->AddChild(new (root) CItem(IsDriveRoot(path) ? IT_DRIVE : IT_DIRECTORY, path));
+        }
+        return root;
+    }
+
+    const auto root = ::new CItem((IsDriveRoot(m_Roots[0]) ? IT_DRIVE : IT_DIRECTORY) | ITF_ROOTITEM, m_Roots[0]);
+    root->UpdateStatsFromDisk();
+    return root;
+}
+
+void CHeadlessScan::Print(const std::wstring& text)
+{
+    // Write to the console if there is one; redirected output is written as UTF-8
+    const HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (output == nullptr || output == INVALID_HANDLE_VALUE) return;
+
+    const std::wstring line = text + L"\r\n";
+    DWORD written = 0;
+    if (DWORD mode = 0; GetConsoleMode(output, &mode))
+    {
+        WriteConsole(output, line.c_str(), static_cast<DWORD>(line.size()), &written, nullptr);
+        return;
+    }
+
+    const int size = WideCharToMultiByte(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), nullptr, 0, nullptr, nullptr);
+    std::string utf8(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), utf8.data(), size, nullptr, nullptr);
+    WriteFile(output, utf8.data(), static_cast<DWORD>(utf8.size()), &written, nullptr);
+}
+
+int CHeadlessScan::Run()
+{
+    // Report to the console this was started from
+    AttachConsole(ATTACH_PARENT_PROCESS);
+
+    if (!ParseArguments())
+    {
+        Print(L"Usage: windirstat.exe /scan [/threads N] [/out results.csv] [/stats stats.json] root...");
+        return ExitUsage;
+    }
+
+    for (const auto& path : m_Roots)
+    {
+        if (FileFindEnhanced::DoesFileExist(path)) continue;
+        Print(std::format(L"Root not found: {}", path));
+        return ExitRootMissing;
+    }
+
+    if (COptions::UseBackupRestore && !EnableReadPrivileges())
+    {
+        VTRACE(L"Failed to enable additional privileges.");
+    }
+    CDirStatApp::Get()->ReReadMountPoints();
+
+    if (COptions::ScanningCache)
+    {
+        CScanCache::Get()->Load();
+        CScanCache::Get()->ResetCounters();
+    }
+
+    const std::unique_ptr<CItem> root(CreateRootItem());
+    CScanStatistics::Get()->Start(m_Roots);
+    Scan(root->IsType(IT_MYCOMPUTER) ? root->GetChildren() : std::vector{ root.get() }, m_Threads);
+    CScanStatistics::Get()->Stop();
+    CItem::ScanItemsFinalize(root.get());
+    if (COptions::ScanningCache) CScanCache::Get()->Save();
+
+    const auto snapshot = CScanStatistics::Get()->GetSnapshot();
+    Print(std::format(L"Scanned {} folders and {} files ({}) in {:.3f} s with {} threads per volume",
+        root->GetFoldersCount(), root->GetFilesCount(), FormatBytes(root->GetSizePhysical()),
+        static_cast<double>(snapshot.ElapsedMicroseconds) / 1'000'000.0, m_Threads));
+
+    int exitCode = ExitSuccess;
+    if (!m_StatisticsFile.empty() && !CScanStatistics::Get()->SaveJson(m_StatisticsFile))
+    {
+        Print(std::format(L"Could not write statistics: {}", m_StatisticsFile));
+        exitCode = ExitOutputFailed;
+    }
+    if (!m_OutputFile.empty() && !SaveResults(m_OutputFile, root.get()))
+    {
+        Print(std::format(L"Could not write results: {}", m_OutputFile));
+        exitCode = ExitOutputFailed;
+    }
+
+    return exitCode;
+}
+
+void CHeadlessScan::Scan(const std::vector<CItem*>& items, const unsigned int threads)
+{
+    // Separate into queues per volume the same way the GUI does
+    CItem::BeginScanPass();
+    std::unordered_map<std::wstring, BlockingQueue<CItem*>> queues;
+    for (const auto& item : items)
+    {
+        item->UpwardAddReadJobs(1);
+        item->UpwardSetUndone();
+
+        std::array<WCHAR, MAX_PATH> pathName;
+        const bool found = GetVolumePathName(item->GetPathLong().c_str(),
+            pathName.data(), static_cast<DWORD>(pathName.size())) != 0;
+        queues[found ? pathName.data() : item->GetPath()].Push(item);
+    }
+
+    std::vector<BlockingQueue<CItem*>*> scanQueues;
+    for (auto& queue : queues | std::views::values)
+    {
+        queue.StartThreads(threads, [&queue]()
+        {
+            CItem::ScanItems(&queue);
+        }, COptions::ScanningWorkStealing);
+        scanQueues.push_back(&queue);
+    }
+    CScanStatistics::Get()->SetQueues(scanQueues);
+
+    // Wait for all threads to run out of work and then release them
+    for (auto& queue : queues | std::views::values)
+    {
+        queue.WaitForCompletionOrCancellation();
+        queue.CancelExecution();
+    }
+    CScanStatistics::Get()->SetQueues({});
+    DirectoryHandleCache::Get()->Clear();
+}
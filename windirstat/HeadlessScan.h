@@ -0,0 +1,63 @@
+// HeadlessScan.h - Declaration of CHeadlessScan
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class CItem;
+
+//
+// CHeadlessScan. Scans the roots given on the command line without creating
+// any windows and writes the results as CSV that can be loaded in the GUI:
+//
+//   windirstat.exe /scan [/threads N] [/out results.csv] [/stats stats.json] root...
+//
+// The scan runs on the same engine as the GUI but without a scan observer, so
+// no duplicate detection or view updates take place.
+//
+class CHeadlessScan final
+{
+public:
+    enum ExitCode : int
+    {
+        ExitSuccess = 0,
+        ExitUsage = 1,        // Invalid command line
+        ExitRootMissing = 2,  // A root does not exist
+        ExitOutputFailed = 3  // The results could not be written
+    };
+
+    static bool IsRequested();
+    int Run();
+
+    // Runs the scanning engine on the items and waits for it to finish
+    static void Scan(const std::vector<CItem*>& items, unsigned int threads);
+    static void Print(const std::wstring& text);
+
+private:
+    bool ParseArguments();
+    CItem* CreateRootItem() const;
+
+    std::vector<std::wstring> m_Roots;
+    std::wstring m_OutputFile;
+    std::wstring m_StatisticsFile;
+    unsigned int m_Threads = 0;
+};
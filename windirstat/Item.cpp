@@ -20,8 +20,6 @@
 //
 
 #include "stdafx.h"
-#include "aclapi.h"
-#include "sddl.h"
 
 #include "WinDirStat.h"
 #include "DirStatDoc.h"
@@ -30,49 +28,51 @@
 #include "GlobalHelpers.h"
 #include "SelectObject.h"
 #include "Item.h"
+#include "ItemReclaimer.h"
 #include "BlockingQueue.h"
 #include "Localization.h"
+#include "OwnerCache.h"
+#include "ScanCache.h"
+#include "ScanStatistics.h"
 #include "SmartPointer.h"
 
 #include <string>
 #include <algorithm>
-#include <unordered_set>
+#include <unordered_map>
 #include <functional>
 #include <queue>
+#include <ranges>
 #include <shared_mutex>
 #include <stack>
 #include <array>
+#include <utility>
 
-CItem::CItem(const ITEMTYPE type, const std::wstring & name) : m_Name(name), m_Type(type)
+CItem::CItem(const ITEMTYPE type, const std::wstring & name) : m_Type(type)
 {
-    if (IsType(IT_DRIVE))
+    // Only roots create an arena; everything else already lives in its parent's
+    CItemArena* arena = nullptr;
+    if (IsType(ITF_ROOTITEM))
     {
-        m_Name = FormatVolumeNameOfRootPath(m_Name);
+        auto rootArena = std::make_unique<CItemArena>();
+        arena = rootArena.get();
+        std::lock_guard lock(m_RootArenasMutex);
+        m_RootArenas.emplace(this, std::move(rootArena));
     }
+    else arena = CItemArena::Of(this);
+
+    m_Name = IsType(IT_DRIVE) ? arena->StoreName(FormatVolumeNameOfRootPath(name)) : arena->StoreName(name);
 
     if (IsType(IT_FILE))
     {
         if (const LPCWSTR ext = wcsrchr(name.c_str(), L'.'); ext != nullptr)
         {
-            std::wstring extToAdd(&ext[0]);
-            _wcslwr_s(extToAdd.data(), extToAdd.size() + 1);
-
-            static std::shared_mutex extLock;
-            static std::unordered_set<std::wstring> extcache;
-            std::lock_guard lock(extLock);
-            const auto cached = extcache.insert(std::move(extToAdd));
-            m_Extension = cached.first->c_str();
-        }
-        else
-        {
-            static LPCWSTR noext = L"";
-            m_Extension = noext;
+            m_ExtensionId = CExtensionTable::Get()->Intern(ext);
         }
+        CountExtension(0, 1);
     }
     else
     {
-        m_FolderInfo = new CHILDINFO;
-        m_Extension = m_Name.c_str();
+        m_FolderInfo = new (arena->AllocateSlot(CItemArena::ChildInfoSlab)) CHILDINFO;
     }
 }
 
@@ -80,8 +80,9 @@ CItem::CItem(const ITEMTYPE type, const std::wstring& name, const FILETIME lastC
              const ULONGLONG sizePhysical, const ULONGLONG sizeLogical,
              const DWORD attributes, const ULONG files, const ULONG subdirs) : CItem(type, name)
 {
-    m_LastChange = lastChange;
+    m_LastChange = ToItemTime(lastChange);
     m_SizePhysical = sizePhysical;
+    CountExtension(static_cast<LONGLONG>(sizePhysical), 0);
     m_SizeLogical = sizeLogical;
     m_Attributes = attributes;
     if (m_FolderInfo != nullptr)
@@ -93,24 +94,74 @@ CItem::CItem(const ITEMTYPE type, const std::wstring& name, const FILETIME lastC
 
 CItem::~CItem()
 {
+    // Children are deleted by operator delete or released with the arena
     if (m_FolderInfo != nullptr)
     {
-        for (const auto& m_Child : m_FolderInfo->m_Children)
+        DirectoryHandleCache::Get()->Forget(this);
+        m_FolderInfo->~CHILDINFO();
+        CItemArena::Free(m_FolderInfo);
+    }
+
+    CountExtension(-static_cast<LONGLONG>(m_SizePhysical), -1);
+}
+
+void* CItem::operator new(const size_t size, const CItem* parent)
+{
+    ASSERT(size == sizeof(CItem));
+    return parent->GetArena()->AllocateSlot(CItemArena::ItemSlab);
+}
+
+void CItem::operator delete(void* slot, const CItem* /*parent*/)
+{
+    CItemArena::Free(slot);
+}
+
+void CItem::operator delete(void* slot)
+{
+    CItemArena::Free(slot);
+}
+
+void CItem::operator delete(CItem* item, std::destroying_delete_t)
+{
+    // Deleting a root releases everything in its arena at once, so subtrees of it
+    // that are still queued for deletion have to be gone first
+    if (item->IsRootItem())
+    {
+        CItemReclaimer::Get()->Drain();
+        std::unique_ptr<CItemArena> arena;
+        {
+            std::lock_guard lock(m_RootArenasMutex);
+            if (auto node = m_RootArenas.extract(item); !node.empty()) arena = std::move(node.mapped());
+        }
+        item->~CItem();
+        ::operator delete(item);
+        return;
+    }
+
+    // Delete single subtrees without recursion so deep paths cannot exhaust the stack
+    std::vector<CItem*> pending{ item };
+    while (!pending.empty())
+    {
+        CItem* next = pending.back();
+        pending.pop_back();
+        if (next->m_FolderInfo != nullptr)
         {
-            delete m_Child;
+            pending.insert(pending.end(), next->m_FolderInfo->m_Children.begin(), next->m_FolderInfo->m_Children.end());
         }
-        delete m_FolderInfo;
+        next->~CItem();
+        CItemArena::Free(next);
     }
 }
 
 CRect CItem::TmiGetRectangle() const
 {
-    return m_Rect;
+    return { m_Rect.left, m_Rect.top, m_Rect.right, m_Rect.bottom };
 }
 
 void CItem::TmiSetRectangle(const CRect& rc)
 {
-    m_Rect = rc;
+    m_Rect = { static_cast<short>(rc.left), static_cast<short>(rc.top),
+        static_cast<short>(rc.right), static_cast<short>(rc.bottom) };
 }
 
 bool CItem::DrawSubitem(const int subitem, CDC* pdc, CRect rc, const UINT state, int* width, int* focusLeft) const
@@ -221,7 +272,7 @@ std::wstring CItem::GetText(const int subitem) const
     case COL_LASTCHANGE:
         if (!IsType(IT_FREESPACE | IT_UNKNOWN))
         {
-            return FormatFileTime(m_LastChange);
+            return FormatFileTime(GetLastChange());
         }
         break;
 
@@ -280,7 +331,7 @@ int CItem::CompareSibling(const CTreeListItem* tlib, const int subitem) const
             }
             else
             {
-                return signum(_wcsicmp(m_Name.c_str(),other->m_Name.c_str()));
+                return signum(_wcsicmp(m_Name,other->m_Name));
             }
         }
 
@@ -385,14 +436,14 @@ short CItem::GetImageToCache() const
         return GetIconImageList()->GetUnknownImage();
     }
 
-    const std::wstring longpath = GetPathLong();
-    if (CDirStatApp::Get()->GetReparseInfo()->IsVolumeMountPoint(longpath, m_Attributes))
+    // Only mount point tags need the path to tell volumes from junctions
+    const DWORD tag = GetReparseTag();
+    const bool mountPoint = CReparsePoints::IsDirectoryReparsePoint(m_Attributes) && tag == IO_REPARSE_TAG_MOUNT_POINT;
+    if (mountPoint && CDirStatApp::Get()->GetReparseInfo()->IsVolumeMountPoint(GetPathLong(), m_Attributes, tag))
     {
         return GetIconImageList()->GetMountPointImage();
     }
-    if ((CReparsePoints::IsSymbolicLink(longpath, m_Attributes) ||
-        CDirStatApp::Get()->GetReparseInfo()->IsJunction(longpath, m_Attributes)) &&
-        !CReparsePoints::IsCloudLink(longpath, m_Attributes))
+    if (mountPoint || CReparsePoints::IsSymbolicLink(m_Attributes, tag))
     {
         constexpr DWORD mask = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM;
         const bool osFile = (GetAttributes() & mask) == mask;
@@ -484,6 +535,7 @@ void CItem::UpdateStatsFromDisk()
         {
             SetLastChange(finder.GetLastWriteTime());
             SetAttributes(finder.GetAttributes());
+            SetReparseTag(finder.GetReparseTag());
 
             if (IsType(IT_FILE))
             {
@@ -500,9 +552,215 @@ void CItem::UpdateStatsFromDisk()
             FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr));
         if (handle != INVALID_HANDLE_VALUE)
         {
-            GetFileTime(handle, nullptr, nullptr, &m_LastChange);
+            if (FILETIME lastChange; GetFileTime(handle, nullptr, nullptr, &lastChange)) SetLastChange(lastChange);
+        }
+    }
+}
+
+// Children and totals of one directory that are gathered locally during
+// enumeration. The children are spliced into the directory under a single lock
+// and the totals are published to all ancestors with a single upward walk.
+// This also happens if enumeration is aborted by a cancellation.
+struct CDirectoryBatch final
+{
+    CItem* m_Item;
+    std::vector<CItem*>& m_Children;
+    ULONGLONG m_SizePhysical = 0;
+    ULONGLONG m_SizeLogical = 0;
+    FILETIME m_LastChange = { 0, 0 };
+    ULONG m_Files = 0;
+    ULONG m_Folders = 0;
+
+    explicit CDirectoryBatch(CItem* item) : m_Item(item), m_Children(Buffer()) {}
+    CDirectoryBatch(const CDirectoryBatch&) = delete;
+    CDirectoryBatch& operator=(const CDirectoryBatch&) = delete;
+
+    ~CDirectoryBatch()
+    {
+        m_Item->AddChildren(m_Children);
+        m_Children.clear();
+
+        m_Item->UpwardAddFolders(m_Folders);
+        m_Item->UpwardAddFiles(m_Files);
+        m_Item->UpwardAddSizePhysical(m_SizePhysical);
+        m_Item->UpwardAddSizeLogical(m_SizeLogical);
+        if (FILETIME{ 0, 0 } < m_LastChange) m_Item->UpwardUpdateLastChange(m_LastChange);
+    }
+
+    static std::vector<CItem*>& Buffer()
+    {
+        // Reused between directories to avoid regrowth on every enumeration
+        thread_local std::vector<CItem*> buffer;
+        return buffer;
+    }
+
+    void Add(CItem* child)
+    {
+        m_Children.push_back(child);
+        m_SizePhysical += child->GetSizePhysical();
+        m_SizeLogical += child->GetSizeLogical();
+        UpdateLastChange(child->GetLastChange());
+    }
+
+    void UpdateLastChange(const FILETIME& lastChange)
+    {
+        if (m_LastChange < lastChange) m_LastChange = lastChange;
+    }
+};
+
+void CItem::UpdateChildrenFromDisk(BlockingQueue<CItem*>& queue)
+{
+    // Shallow merges only descend into subfolders that are pending themselves
+    const bool shallow = IsType(ITF_SHALLOW);
+
+    // Index the current children so each entry on disk is matched at most once
+    std::unordered_map<std::wstring, CItem*> existing;
+    for (const auto& child : GetChildren())
+    {
+        if (!child->IsType(IT_FILE | IT_DIRECTORY)) continue;
+        std::wstring name = child->GetName();
+        existing.emplace(MakeLower(name), child);
+    }
+
+    const ULONGLONG start = CScanStatistics::Now();
+    FileFindEnhanced finder;
+    BOOL b = OpenForScan(finder, true);
+    if (!b) return;
+
+    // Totals are published to the ancestors once at the end
+    CDirectoryBatch batch(this);
+    ULONGLONG removedPhysical = 0;
+    ULONGLONG removedLogical = 0;
+    ULONG removedFiles = 0;
+    ULONG removedFolders = 0;
+    ULONG queued = 0;
+    size_t entries = 0;
+    for (; b; b = finder.FindNextFile())
+    {
+        if (finder.IsDots() || IsExcludedFromScan(finder))
+        {
+            continue;
+        }
+
+        entries++;
+
+        // Entries that kept their type are patched in place; a folder's own
+        // contents are only refreshed through the queue, and for shallow
+        // merges only if it is pending itself
+        std::wstring name = finder.GetFileName();
+        if (const auto match = existing.find(MakeLower(name)); match != existing.end() &&
+            match->second->IsType(IT_DIRECTORY) == finder.IsDirectory())
+        {
+            CItem* child = match->second;
+            existing.erase(match);
+            child->SetAttributes(finder.GetAttributes());
+            child->SetReparseTag(finder.GetReparseTag());
+
+            if (child->IsType(IT_DIRECTORY))
+            {
+                if (child->GetLastChange() < finder.GetLastWriteTime())
+                {
+                    child->SetLastChange(finder.GetLastWriteTime());
+                    batch.UpdateLastChange(child->GetLastChange());
+                }
+                if ((!shallow || !child->IsDone()) && IsFollowedDuringScan(finder))
+                {
+                    child->SetType(ITF_DONE, false);
+                    child->UpwardAddReadJobs(1);
+                    PushForScan(&queue, child);
+                    queued++;
+                }
+                continue;
+            }
+
+            if (child->GetSizeLogical() == finder.GetFileSizeLogical() &&
+                child->GetSizePhysical() == finder.GetFileSizePhysical() &&
+                child->HasLastChange(finder.GetLastWriteTime()))
+            {
+                continue;
+            }
+
+            if (m_Observer != nullptr) m_Observer->OnDuplicateCandidateRemoved(child);
+            removedPhysical += child->GetSizePhysical();
+            removedLogical += child->GetSizeLogical();
+            child->SetSizePhysical(finder.GetFileSizePhysical());
+            child->SetSizeLogical(finder.GetFileSizeLogical());
+            child->SetLastChange(finder.GetLastWriteTime());
+            batch.m_SizePhysical += child->GetSizePhysical();
+            batch.m_SizeLogical += child->GetSizeLogical();
+            batch.UpdateLastChange(child->GetLastChange());
+
+            // The contents changed so earlier hashes no longer apply
+            if (m_Observer != nullptr)
+            {
+                child->SetType(ITF_PARTHASH | ITF_FULLHASH, false);
+                m_Observer->OnDuplicateCandidate(child, &queue);
+            }
+            continue;
+        }
+
+        if (finder.IsDirectory())
+        {
+            batch.m_Folders++;
+            CItem* child = AddDirectory(finder);
+            batch.Add(child);
+            if (child->GetReadJobs() > 0)
+            {
+                PushForScan(&queue, child);
+                queued++;
+            }
+        }
+        else
+        {
+            batch.m_Files++;
+            CItem* child = AddFile(finder);
+            batch.Add(child);
+            if (m_Observer != nullptr) m_Observer->OnDuplicateCandidate(child, &queue);
         }
+
+        queue.WaitIfSuspended();
+    }
+
+    // Whatever was not seen on disk anymore has been removed
+    for (const auto& child : existing | std::views::values)
+    {
+        if (m_Observer != nullptr) m_Observer->OnDuplicateCandidateRemoved(child);
+        removedPhysical += child->GetSizePhysical();
+        removedLogical += child->GetSizeLogical();
+        removedFiles += child->GetFilesCount() + (child->IsType(IT_FILE) ? 1 : 0);
+        removedFolders += child->GetFoldersCount() + (child->IsType(IT_FILE) ? 0 : 1);
+        RemoveChild(child);
+    }
+
+    UpwardSubtractSizePhysical(removedPhysical);
+    UpwardSubtractSizeLogical(removedLogical);
+    UpwardSubtractFiles(removedFiles);
+    UpwardSubtractFolders(removedFolders);
+    DirectoryHandleCache::Get()->Seal(this, queued);
+    SetScanTime(CScanStatistics::Now() - start, finder.GetFileSystemTime());
+    queue.AddProgress(entries);
+    CScanStatistics::Add(CScanStatistics::Local().Directories, 1);
+    CScanStatistics::Add(CScanStatistics::Local().Entries, entries);
+}
+
+CItem* CItem::FindDescendant(const std::wstring& relativePath)
+{
+    CItem* item = this;
+    for (size_t start = 0; start < relativePath.size() && item != nullptr;)
+    {
+        const size_t end = std::min(relativePath.find(L'\\', start), relativePath.size());
+        const std::wstring name = relativePath.substr(start, end - start);
+        start = end + 1;
+
+        const auto& children = item->GetChildren();
+        const auto child = std::ranges::find_if(children, [&name](const CItem* c)
+        {
+            return !c->IsType(IT_FILE) && _wcsicmp(c->GetName().c_str(), name.c_str()) == 0;
+        });
+        item = child != children.end() ? *child : nullptr;
     }
+
+    return item;
 }
 
 const std::vector<CItem*>& CItem::GetChildren() const
@@ -521,53 +779,59 @@ void CItem::AddChild(CItem* child, const bool addOnly)
     {
         UpwardAddSizePhysical(child->m_SizePhysical);
         UpwardAddSizeLogical(child->m_SizeLogical);
-        UpwardUpdateLastChange(child->m_LastChange);
+        UpwardUpdateLastChange(child->GetLastChange());
     }
 
     child->SetParent(this);
 
-    std::lock_guard guard(m_FolderInfo->m_Protect);
-    m_FolderInfo->m_Children.push_back(child);
+    {
+        std::lock_guard guard(m_FolderInfo->m_Protect);
+        m_FolderInfo->m_Children.push_back(child);
+    }
+
+    if (m_Observer != nullptr) m_Observer->OnChildAdded(this, child);
+}
+
+void CItem::AddChildren(const std::vector<CItem*>& children)
+{
+    if (children.empty()) return;
 
-    if (IsVisible() && IsExpanded())
     {
-        (void)GetImage();
-        CMainFrame::Get()->InvokeInMessageThread([this, child]
+        std::lock_guard guard(m_FolderInfo->m_Protect);
+        auto& list = m_FolderInfo->m_Children;
+        list.reserve(list.size() + children.size());
+        for (const auto& child : children)
         {
-            CFileTreeControl::Get()->OnChildAdded(this, child);
-        });
+            child->SetParent(this);
+            list.push_back(child);
+        }
     }
+
+    if (m_Observer != nullptr) m_Observer->OnChildrenAdded(this, children);
 }
 
 void CItem::RemoveChild(CItem* child)
 {
-    std::lock_guard guard(m_FolderInfo->m_Protect);
-    std::erase(m_FolderInfo->m_Children, child);
-
-    if (IsVisible())
     {
-        CMainFrame::Get()->InvokeInMessageThread([this, child]
-        {
-            CFileTreeControl::Get()->OnChildRemoved(this, child);
-        });
+        std::lock_guard guard(m_FolderInfo->m_Protect);
+        std::erase(m_FolderInfo->m_Children, child);
     }
 
+    // Notify without the lock; the observer waits for the message thread
+    // which may be reading our children at the same time
+    if (m_Observer != nullptr) m_Observer->OnChildRemoved(this, child);
+
     delete child;
 }
 
 void CItem::RemoveAllChildren()
 {
     if (m_FolderInfo == nullptr) return;
-    CMainFrame::Get()->InvokeInMessageThread([this]
-    {
-        CFileTreeControl::Get()->OnRemovingAllChildren(this);
-    });
+    if (m_Observer != nullptr) m_Observer->OnRemovingAllChildren(this);
 
+    // The subtrees are deleted in the background so a refresh can start right away
     std::lock_guard guard(m_FolderInfo->m_Protect);
-    for (const auto& child : m_FolderInfo->m_Children)
-    {
-        delete child;
-    }
+    CItemReclaimer::Get()->Reclaim(std::move(m_FolderInfo->m_Children));
     m_FolderInfo->m_Children.clear();
 }
 
@@ -616,6 +880,7 @@ void CItem::UpwardSubtractFiles(const ULONG fileCount)
 void CItem::UpwardAddSizePhysical(const ULONGLONG bytes)
 {
     if (bytes == 0) return;
+    CountExtension(static_cast<LONGLONG>(bytes), 0);
     for (auto p = this; p != nullptr; p = p->GetParent())
     {
         p->m_SizePhysical += bytes;
@@ -625,6 +890,7 @@ void CItem::UpwardAddSizePhysical(const ULONGLONG bytes)
 void CItem::UpwardSubtractSizePhysical(const ULONGLONG bytes)
 {
     if (bytes == 0) return;
+    CountExtension(-static_cast<LONGLONG>(bytes), 0);
     for (auto p = this; p != nullptr; p = p->GetParent())
     {
         ASSERT(p->m_SizePhysical - bytes >= 0);
@@ -677,9 +943,10 @@ void CItem::UpwardSubtractReadJobs(const ULONG count)
 // This method increases the last change
 void CItem::UpwardUpdateLastChange(const FILETIME& t)
 {
+    const ULONG time = ToItemTime(t);
     for (auto p = this; p != nullptr; p = p->GetParent())
     {
-        if (CompareFileTime(&t, &p->m_LastChange) == 1) p->m_LastChange = t;
+        if (time > p->m_LastChange) p->m_LastChange = time;
     }
 }
 
@@ -693,7 +960,7 @@ void CItem::UpwardRecalcLastChange(const bool withoutItem)
         for (const auto& child : p->GetChildren())
         {
             if (withoutItem && child == this) continue;
-            if (CompareFileTime(&child->m_LastChange, &p->m_LastChange) == 1)
+            if (child->m_LastChange > p->m_LastChange)
                 p->m_LastChange = child->m_LastChange;
         }
     }
@@ -712,7 +979,26 @@ ULONGLONG CItem::GetSizeLogical() const
 void CItem::SetSizePhysical(const ULONGLONG size)
 {
     ASSERT(size >= 0);
-    m_SizePhysical = size;
+    const ULONGLONG previous = std::exchange(m_SizePhysical, size);
+    CountExtension(static_cast<LONGLONG>(size - previous), 0);
+}
+
+CItemArena* CItem::GetArena() const
+{
+    // Roots are allocated outside their arena but their child information is not,
+    // and every item that can be a parent has child information
+    ASSERT(m_FolderInfo != nullptr);
+    return CItemArena::Of(m_FolderInfo);
+}
+
+void CItem::CountExtension(const LONGLONG bytes, const LONGLONG files) const
+{
+    // Files live in the arena of their tree, which keeps the statistics
+    if (!IsType(IT_FILE) || IsRootItem()) return;
+    if (const auto statistics = CItemArena::GetExtensionStatistics(this); statistics != nullptr)
+    {
+        statistics->Add(m_ExtensionId, bytes, files);
+    }
 }
 
 void CItem::SetSizeLogical(const ULONGLONG size)
@@ -729,12 +1015,35 @@ ULONG CItem::GetReadJobs() const
 
 FILETIME CItem::GetLastChange() const
 {
-    return m_LastChange;
+    return FromItemTime(m_LastChange);
 }
 
 void CItem::SetLastChange(const FILETIME& t)
 {
-    m_LastChange = t;
+    m_LastChange = ToItemTime(t);
+}
+
+bool CItem::HasLastChange(const FILETIME& t) const
+{
+    return m_LastChange == ToItemTime(t);
+}
+
+ULONG CItem::ToItemTime(const FILETIME& t)
+{
+    // Times before 1970 are stored as zero which reads back as no time at all
+    constexpr ULONGLONG ticksPerSecond = 10'000'000ull;
+    constexpr ULONGLONG secondsTo1970 = 11'644'473'600ull;
+    const ULONGLONG seconds = (static_cast<ULONGLONG>(t.dwHighDateTime) << 32 | t.dwLowDateTime) / ticksPerSecond;
+    return static_cast<ULONG>(std::clamp(seconds, secondsTo1970, secondsTo1970 + ULONG_MAX) - secondsTo1970);
+}
+
+FILETIME CItem::FromItemTime(const ULONG t)
+{
+    if (t == 0) return { 0, 0 };
+    constexpr ULONGLONG ticksPerSecond = 10'000'000ull;
+    constexpr ULONGLONG secondsTo1970 = 11'644'473'600ull;
+    const ULONGLONG ticks = (t + secondsTo1970) * ticksPerSecond;
+    return { static_cast<DWORD>(ticks), static_cast<DWORD>(ticks >> 32) };
 }
 
 void CItem::SetAttributes(const DWORD attr)
@@ -748,6 +1057,26 @@ DWORD CItem::GetAttributes() const
     return m_Attributes;
 }
 
+void CItem::SetReparseTag(const DWORD tag)
+{
+    m_ReparseTag = tag;
+}
+
+DWORD CItem::GetReparseTag() const
+{
+    // Items that were not enumerated (e.g. loaded from a file) ask the file system
+    // once; a failed query is remembered as a reserved tag that never occurs on disk
+    constexpr DWORD unavailable = IO_REPARSE_TAG_RESERVED_ONE;
+    DWORD tag = m_ReparseTag.load(std::memory_order_relaxed);
+    if (tag == 0 && CReparsePoints::IsReparsePoint(m_Attributes) && !IsOffline())
+    {
+        tag = CReparsePoints::GetReparseTag(GetPathLong());
+        m_ReparseTag.store(tag != 0 ? tag : unavailable, std::memory_order_relaxed);
+    }
+
+    return tag != unavailable ? tag : 0;
+}
+
 // Returns a value which resembles sorting of RHSACE considering gaps
 unsigned short CItem::GetSortAttributes() const
 {
@@ -780,6 +1109,13 @@ bool CItem::IsRootItem() const
     return (m_Type & ITF_ROOTITEM) != 0;
 }
 
+bool CItem::IsOffline() const
+{
+    auto root = this;
+    while (root->GetParent() != nullptr) root = root->GetParent();
+    return root->IsType(ITF_OFFLINE);
+}
+
 std::wstring CItem::GetPath() const
 {
     std::wstring path = UpwardGetPathWithoutBackslash();
@@ -802,20 +1138,30 @@ std::wstring CItem::GetOwner(const bool force) const
         return {};
     }
 
+    // Owners fetched during the scan or for an export only need their name
+    if (m_OwnerIndex != 0) return COwnerCache::Get()->GetName(m_OwnerIndex);
+
     // If visible, use cached variable
     std::wstring tmp;
     std::wstring & ret = (force) ? tmp : m_VisualInfo->owner;
     if (!ret.empty()) return ret;
 
-    // Fetch owner information from drive
-    SmartPointer<PSECURITY_DESCRIPTOR> ps(LocalFree);
-    PSID sid = nullptr;
-    GetNamedSecurityInfo(GetPathLong().c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION,
-        &sid, nullptr, nullptr, nullptr, &ps);
-    ret = GetNameFromSid(sid);
+    // Fetch owner information from drive; images have nothing to ask
+    if (IsOffline()) return ret;
+    ret = COwnerCache::Get()->GetName(COwnerCache::Get()->QueryOwner(GetPathLong()));
     return ret;
 }
 
+void CItem::SetOwnerIndex(const unsigned short index)
+{
+    m_OwnerIndex = index;
+}
+
+unsigned short CItem::GetOwnerIndex() const
+{
+    return m_OwnerIndex;
+}
+
 bool CItem::HasUncPath() const
 {
     const std::wstring path = GetPath();
@@ -851,7 +1197,13 @@ std::wstring CItem::GetName() const
 
 std::wstring CItem::GetExtension() const
 {
-    return m_Extension;
+    // Folders historically report their name
+    return IsType(IT_FILE) ? CExtensionTable::Get()->GetName(m_ExtensionId) : m_Name;
+}
+
+CExtensionTable::Id CItem::GetExtensionId() const
+{
+    return m_ExtensionId;
 }
 
 ULONG CItem::GetFilesCount() const
@@ -893,6 +1245,7 @@ void CItem::SetDone()
     }
 
     m_Rect = { 0,0,0,0 };
+    SetType(ITF_SHALLOW, false);
     SetType(ITF_DONE, true);
 }
 
@@ -916,6 +1269,23 @@ ULONGLONG CItem::GetTicksWorked() const
         (m_FolderInfo->m_Tstart > 0) ? ((GetTickCount64() / 1000ull) - m_FolderInfo->m_Tstart) : 0;
 }
 
+void CItem::SetScanTime(const ULONGLONG wall, const ULONGLONG fileSystem) const
+{
+    if (m_FolderInfo == nullptr) return;
+    m_FolderInfo->m_ScanTime = wall;
+    m_FolderInfo->m_ScanFileSystemTime = fileSystem;
+}
+
+ULONGLONG CItem::GetScanTime() const
+{
+    return m_FolderInfo != nullptr ? m_FolderInfo->m_ScanTime.load() : 0;
+}
+
+ULONGLONG CItem::GetScanFileSystemTime() const
+{
+    return m_FolderInfo != nullptr ? m_FolderInfo->m_ScanFileSystemTime.load() : 0;
+}
+
 void CItem::ResetScanStartTime() const
 {
     if (m_FolderInfo != nullptr)
@@ -928,70 +1298,204 @@ void CItem::ResetScanStartTime() const
 void CItem::ScanItemsFinalize(CItem* item)
 {
     if (item == nullptr) return;
-    std::stack<CItem*> queue({item});
-    while (!queue.empty())
-    {
-        const auto & qitem = queue.top();
-        queue.pop();
-        qitem->SetDone();
-        if (qitem->IsType(IT_FILE)) continue;
+
+    // The root and the drives below it replace their free space and unknown
+    // items when done, so they are collected here and finalized serially
+    // once every folder below them is
+    std::vector<CItem*> containers;
+    std::vector<CItem*> folders;
+    for (std::stack<CItem*> pending({ item }); !pending.empty();)
+    {
+        CItem* qitem = pending.top();
+        pending.pop();
+        containers.push_back(qitem);
+        if (qitem->TmiIsLeaf()) continue;
         for (const auto& child : qitem->GetChildren())
         {
-            if (!child->IsDone()) queue.push(child);
+            if (child->IsDone() || child->TmiIsLeaf()) continue;
+            if (child->IsType(IT_DIRECTORY)) folders.push_back(child);
+            else pending.push(child);
+        }
+    }
+
+    // Folders are finalized on worker threads like they are scanned. Folders
+    // that finished during the scan were sorted then and are skipped along
+    // with their subtree.
+    if (!folders.empty())
+    {
+        BlockingQueue<CItem*> queue;
+        for (const auto& folder : folders) queue.Push(folder);
+        queue.StartThreads(COptions::ScanningThreads, [&queue]
+        {
+            for (;;)
+            {
+                CItem* qitem = queue.Pop();
+                qitem->SetDone();
+                for (const auto& child : qitem->GetChildren())
+                {
+                    if (child->IsDone()) continue;
+                    if (child->IsType(IT_FILE)) child->SetDone();
+                    else queue.Push(child);
+                }
+            }
+        }, true);
+
+        // Workers leave through the cancellation once everything is done
+        queue.WaitForCompletionOrCancellation();
+        queue.CancelExecution();
+    }
+
+    // Children before parents so each container sorts its final children
+    for (const auto& container : containers | std::views::reverse)
+    {
+        container->SetDone();
+        if (container->TmiIsLeaf()) continue;
+        for (const auto& child : container->GetChildren())
+        {
+            if (child->TmiIsLeaf()) child->SetDone();
         }
     }
 }
 
+bool CItem::IsExcludedFromScan(const FileFindEnhanced& finder)
+{
+    if (finder.IsDirectory())
+    {
+        return COptions::ExcludeHiddenDirectory && finder.IsHidden() ||
+            COptions::ExcludeProtectedDirectory && finder.IsHiddenSystem();
+    }
+
+    return COptions::ExcludeHiddenFile && finder.IsHidden() ||
+        COptions::ExcludeProtectedFile && finder.IsHiddenSystem() ||
+        COptions::ExcludeSymbolicLinksFile && CReparsePoints::IsSymbolicLink(finder.GetAttributes(), finder.GetReparseTag());
+}
+
+void CItem::BeginScanPass()
+{
+    m_CurrentScanPass++;
+}
+
+void CItem::SetObserver(CScanObserver* observer)
+{
+    m_Observer = observer;
+}
+
+bool CItem::ClaimScan()
+{
+    // Urgent entries may duplicate normal ones so only the first one enumerates
+    if (m_FolderInfo == nullptr) return true;
+    return m_FolderInfo->m_ScanPass.exchange(m_CurrentScanPass) != m_CurrentScanPass;
+}
+
+bool CItem::IsScanPending() const
+{
+    return m_FolderInfo != nullptr && !IsDone() && GetReadJobs() > 0 &&
+        m_FolderInfo->m_ScanPass != m_CurrentScanPass;
+}
+
+bool CItem::OpenForScan(FileFindEnhanced& finder, const bool shareHandle)
+{
+    // Opening relative to the still open parent spares resolving the whole path
+    auto backend = COptions::ScanningCache ? CScanCache::Get()->CreateBackend() : FileFindBackend::Create();
+    const auto parent = shareHandle && GetParent() != nullptr ?
+        DirectoryHandleCache::Get()->Acquire(GetParent()) : DirectoryHandle();
+    const bool found = parent != nullptr ?
+        finder.FindFile(GetName(), parent, [this] { return GetPath(); }, std::move(backend)) :
+        finder.FindFile(GetPath(), {}, std::move(backend));
+    if (found && shareHandle) DirectoryHandleCache::Get()->Register(this, finder.GetDirectoryHandle());
+    return found;
+}
+
+void CItem::PushForScan(BlockingQueue<CItem*>* queue, CItem* item)
+{
+    // Folders shown in the file tree or inside the zoomed folder run ahead of the rest
+    const CItem* parent = item->GetParent();
+    if (m_Observer == nullptr)
+    {
+        queue->Push(item);
+        return;
+    }
+
+    const CItem* zoom = m_Observer->GetPriorityItem();
+    if (parent != nullptr && parent->IsVisible() && parent->IsExpanded() ||
+        zoom != nullptr && !zoom->IsRootItem() && zoom->IsAncestorOf(item))
+    {
+        queue->PushUrgent(item);
+        return;
+    }
+
+    queue->Push(item);
+}
+
 void CItem::ScanItems(BlockingQueue<CItem*> * queue)
 {
-    while (CItem * item = queue->Pop())
+    auto& statistics = CScanStatistics::Local();
+    for (;;)
     {
+        // Time spent waiting for work counts as idle
+        const ULONGLONG idleStart = CScanStatistics::Now();
+        CItem* item = queue->Pop();
+        CScanStatistics::Add(statistics.IdleMicroseconds, CScanStatistics::Now() - idleStart);
+        if (item == nullptr) break;
+
+        if (!item->ClaimScan())
+        {
+            continue;
+        }
+
         // Mark the time we started evaluating this node
         item->ResetScanStartTime();
 
-        if (item->IsType(IT_DRIVE | IT_DIRECTORY))
+        if (item->IsType(IT_DRIVE | IT_DIRECTORY) && !item->GetChildren().empty())
         {
+            // Still holds the children of an earlier scan so merge with what is on disk
+            item->UpdateChildrenFromDisk(*queue);
+        }
+        else if (item->IsType(IT_DRIVE | IT_DIRECTORY))
+        {
+            CDirectoryBatch batch(item);
+            const ULONGLONG start = CScanStatistics::Now();
             FileFindEnhanced finder;
-            for (BOOL b = finder.FindFile(item->GetPath()); b; b = finder.FindNextFile())
+            ULONG queued = 0;
+            for (BOOL b = item->OpenForScan(finder, true); b; b = finder.FindNextFile())
             {
                 if (finder.IsDots())
                 {
                     continue;
                 }
 
-                if (finder.IsDirectory())
+                if (IsExcludedFromScan(finder))
                 {
-                    if (COptions::ExcludeHiddenDirectory && finder.IsHidden() ||
-                        COptions::ExcludeProtectedDirectory && finder.IsHiddenSystem())
-                    {
-                        continue;
-                    }
+                    continue;
+                }
 
-                    item->UpwardAddFolders(1);
-                    if (CItem* newitem = item->AddDirectory(finder); newitem->GetReadJobs() > 0)
+                if (finder.IsDirectory())
+                {
+                    batch.m_Folders++;
+                    CItem* newitem = item->AddDirectory(finder);
+                    batch.Add(newitem);
+                    if (newitem->GetReadJobs() > 0)
                     {
-                        queue->Push(newitem);
+                        PushForScan(queue, newitem);
+                        queued++;
                     }
                 }
                 else
                 {
-                    if (COptions::ExcludeHiddenFile && finder.IsHidden() ||
-                        COptions::ExcludeProtectedFile && finder.IsHiddenSystem() ||
-                        COptions::ExcludeSymbolicLinksFile && CReparsePoints::IsReparsePoint(finder.GetAttributes()) &&
-                            CReparsePoints::IsSymbolicLink(finder.GetFilePathLong(), finder.GetAttributes()))
-                    {
-                        continue;
-                    }
-
-                    item->UpwardAddFiles(1);
+                    batch.m_Files++;
                     CItem* newitem = item->AddFile(finder);
-                    CFileDupeControl::Get()->ProcessDuplicate(newitem, queue);
+                    batch.Add(newitem);
+                    if (m_Observer != nullptr) m_Observer->OnDuplicateCandidate(newitem, queue);
                     queue->WaitIfSuspended();
                 }
-
-                // Update pacman position
-                item->UpwardDrivePacman();
             }
+
+            // Feeds the per-volume thread tuning
+            DirectoryHandleCache::Get()->Seal(item, queued);
+            item->SetScanTime(CScanStatistics::Now() - start, finder.GetFileSystemTime());
+            queue->AddProgress(static_cast<size_t>(batch.m_Files) + batch.m_Folders);
+            CScanStatistics::Add(statistics.Directories, 1);
+            CScanStatistics::Add(statistics.Entries, static_cast<ULONGLONG>(batch.m_Files) + batch.m_Folders);
         }
         else if (item->IsType(IT_FILE))
         {
@@ -1063,7 +1567,7 @@ void CItem::CreateFreeSpaceItem()
 
     auto [total, free] = CDirStatApp::GetFreeDiskSpace(GetPath());
 
-    const auto freespace = new CItem(IT_FREESPACE, Localization::Lookup(IDS_FREESPACE_ITEM));
+    const auto freespace = new (this) CItem(IT_FREESPACE, Localization::Lookup(IDS_FREESPACE_ITEM));
     freespace->SetSizePhysical(free);
     freespace->SetDone();
 
@@ -1138,7 +1642,7 @@ void CItem::CreateUnknownItem()
 
     UpwardSetUndone();
 
-    const auto unknown = new CItem(IT_UNKNOWN, Localization::Lookup(IDS_UNKNOWN_ITEM));
+    const auto unknown = new (this) CItem(IT_UNKNOWN, Localization::Lookup(IDS_UNKNOWN_ITEM));
     unknown->SetDone();
 
     AddChild(unknown);
@@ -1170,6 +1674,17 @@ void CItem::RemoveUnknownItem()
 
 void CItem::CollectExtensionData(CExtensionData* ed) const
 {
+    // Whole trees are counted while they are built; subtrees have to be walked
+    if (IsRootItem())
+    {
+        std::lock_guard lock(m_RootArenasMutex);
+        if (const auto arena = m_RootArenas.find(this); arena != m_RootArenas.end())
+        {
+            arena->second->GetExtensionStatistics().Collect(ed);
+            return;
+        }
+    }
+
     std::stack<const CItem*> queue({this});
     while (!queue.empty())
     {
@@ -1177,20 +1692,10 @@ void CItem::CollectExtensionData(CExtensionData* ed) const
         queue.pop();
         if (qitem->IsType(IT_FILE))
         {
-            const std::wstring& ext = qitem->GetExtension();
-            const auto & record = ed->find(ext);
-            if (record != ed->end())
-            {
-                record->second.bytes += qitem->GetSizePhysical();
-                record->second.files++;
-            }
-            else
-            {
-                SExtensionRecord new_record;
-                new_record.bytes = qitem->GetSizePhysical();
-                new_record.files = 1;
-                ed->emplace(ext, new_record);
-            }
+            if (qitem->m_ExtensionId >= ed->size()) ed->resize(CExtensionTable::Get()->GetCount());
+            SExtensionRecord& record = (*ed)[qitem->m_ExtensionId];
+            record.bytes += qitem->GetSizePhysical();
+            record.files++;
         }
         else for (const auto& child : qitem->m_FolderInfo->m_Children)
         {
@@ -1235,7 +1740,7 @@ COLORREF CItem::GetGraphColor() const
 
     if (IsType(IT_FILE))
     {
-        return CDirStatDoc::GetDocument()->GetCushionColor(GetExtension());
+        return CDirStatDoc::GetDocument()->GetCushionColor(m_ExtensionId);
     }
 
     return RGB(0, 0, 0);
@@ -1269,50 +1774,60 @@ COLORREF CItem::GetPercentageColor() const
 
 std::wstring CItem::UpwardGetPathWithoutBackslash() const
 {
-    // allow persistent storage to prevent constant reallocation
-    std::wstring path = L"\\";
-
+    // Collect the components first so the path is built front to back in a
+    // single allocation instead of inserting at the front for every level
+    thread_local std::vector<const CItem*> components;
+    components.clear();
+    size_t length = 0;
     for (auto p = this; p != nullptr; p = p->GetParent())
     {
-        if (p->IsType(IT_DIRECTORY))
-        {
-            path.insert(0, p->m_Name + L"\\");
-        }
-        else if (p->IsType(IT_FILE))
-        {
-            path = p->m_Name;
-        }
-        else if (p->IsType(IT_DRIVE))
-        {
-            path.insert(0, PathFromVolumeName(p->m_Name) + L"\\");
-        }
+        if (!p->IsType(IT_DIRECTORY | IT_FILE | IT_DRIVE)) continue;
+        components.push_back(p);
+        length += wcslen(p->m_Name) + 1;
+    }
+
+    std::wstring path;
+    path.reserve(length);
+    for (const auto& p : components | std::views::reverse)
+    {
+        path += p->IsType(IT_DRIVE) ? PathFromVolumeName(p->m_Name) : p->m_Name;
+        path += L'\\';
     }
 
-    while (path.back() == L'\\') path.pop_back();
+    while (!path.empty() && path.back() == L'\\') path.pop_back();
     return path;
 }
 
+bool CItem::IsFollowedDuringScan(const FileFindEnhanced& finder)
+{
+    return !finder.IsProtectedReparsePoint() &&
+        CDirStatApp::Get()->IsFollowingAllowed(finder.GetFilePathLong(), finder.GetAttributes(), finder.GetReparseTag());
+}
+
 CItem* CItem::AddDirectory(const FileFindEnhanced& finder)
 {
-    const bool follow = !finder.IsProtectedReparsePoint() &&
-        CDirStatApp::Get()->IsFollowingAllowed(finder.GetFilePathLong(), finder.GetAttributes());
+    const bool follow = IsFollowedDuringScan(finder);
 
-    const auto & child = new CItem(IT_DIRECTORY, finder.GetFileName());
+    const auto & child = new (this) CItem(IT_DIRECTORY, finder.GetFileName());
     child->SetLastChange(finder.GetLastWriteTime());
     child->SetAttributes(finder.GetAttributes());
-    AddChild(child);
+    child->SetReparseTag(finder.GetReparseTag());
+    if (COptions::ScanningOwners) child->SetOwnerIndex(COwnerCache::Get()->QueryOwner(finder.GetFilePathLong()));
+    child->SetParent(this);
     child->UpwardAddReadJobs(follow ? 1 : 0);
     return child;
 }
 
 CItem* CItem::AddFile(const FileFindEnhanced& finder)
 {
-    const auto & child = new CItem(IT_FILE, finder.GetFileName());
+    const auto & child = new (this) CItem(IT_FILE, finder.GetFileName());
     child->SetSizePhysical(finder.GetFileSizePhysical());
     child->SetSizeLogical(finder.GetFileSizeLogical());
     child->SetLastChange(finder.GetLastWriteTime());
     child->SetAttributes(finder.GetAttributes());
-    AddChild(child);
+    child->SetReparseTag(finder.GetReparseTag());
+    if (COptions::ScanningOwners) child->SetOwnerIndex(COwnerCache::Get()->QueryOwner(finder.GetFilePathLong()));
+    child->SetParent(this);
     child->SetDone();
     return child;
 }
@@ -1370,6 +1885,7 @@ std::wstring CItem::GetFileHash(ULONGLONG hashSizeLimit, BlockingQueue<CItem*>*
         &iReadBytes, nullptr)) != 0 && iReadBytes > 0)
     {
         UpwardDrivePacman();
+        CScanStatistics::Add(CScanStatistics::Local().BytesHashed, iReadBytes);
         iHashResult = BCryptHashData(HashHandle, FileBuffer.data(), iReadBytes, 0);
         if (iHashResult != 0 || hashSizeLimit > 0) break;
         queue->WaitIfSuspended();
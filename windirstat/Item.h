@@ -26,8 +26,15 @@
 #include "DirStatDoc.h" // CExtensionData
 #include "FileFind.h" // FileFindEnhanced
 #include "BlockingQueue.h"
+#include "ScanObserver.h"
+#include "ItemArena.h"
+#include "ExtensionTable.h"
 
+#include <memory>
+#include <mutex>
+#include <new>
 #include <shared_mutex>
+#include <unordered_map>
 
 // Columns
 enum ITEMCOLUMNS
@@ -60,6 +67,8 @@ enum ITEMTYPE : unsigned short
     ITF_ROOTITEM  = 1 << 9,  // Indicates root item
     ITF_PARTHASH  = 1 << 10, // Indicates a partial hash
     ITF_FULLHASH  = 1 << 11, // Indicates a full hash
+    ITF_SHALLOW   = 1 << 12, // Indicates only the folder itself is merged by the next scan
+    ITF_OFFLINE   = 1 << 13, // Indicates a root loaded from a volume image whose paths do not exist here
     ITF_FLAGS     = 0xFF00,  // All potential flag items
 };
 
@@ -93,6 +102,8 @@ inline bool operator==(const FILETIME& t1, const FILETIME& t2)
 // may be inserted in the TreeList view (we don't clone any data).
 //
 // Of course, this class and the base classes are optimized rather for size than for speed.
+// Items are allocated from the arena of their root (CItemArena), so deleting the
+// root releases the whole tree at once.
 //
 // The m_Type indicates whether we are a file or a folder or a drive etc.
 // It may have been better to design a class hierarchy for this, but I can't help it,
@@ -115,6 +126,14 @@ public:
         ULONGLONG sizeLogical, DWORD attributes, ULONG files, ULONG subdirs);
     ~CItem() override;
 
+    // Items other than roots are created with new (parent) in the arena of their
+    // parent, see CItemArena; root items are created with ::new, own a new arena
+    // and release it when deleted
+    static void* operator new(size_t size, const CItem* parent);
+    static void operator delete(void* slot, const CItem* parent);
+    static void operator delete(void* slot);
+    static void operator delete(CItem* item, std::destroying_delete_t);
+
     // CTreeListItem Interface
     bool DrawSubitem(int subitem, CDC* pdc, CRect rc, UINT state, int* width, int* focusLeft) const override;
     std::wstring GetText(int subitem) const override;
@@ -162,9 +181,12 @@ public:
     ULONGLONG GetProgressRange() const;
     ULONGLONG GetProgressPos() const;
     void UpdateStatsFromDisk();
+    void UpdateChildrenFromDisk(BlockingQueue<CItem*>& queue);
+    CItem* FindDescendant(const std::wstring& relativePath);
     const std::vector<CItem*>& GetChildren() const;
     CItem* GetParent() const;
     void AddChild(CItem* child, bool addOnly = false);
+    void AddChildren(const std::vector<CItem*>& children);
     void RemoveChild(CItem* child);
     void RemoveAllChildren();
     void UpwardAddFolders(ULONG dirCount);
@@ -186,18 +208,25 @@ public:
     ULONG GetReadJobs() const;
     FILETIME GetLastChange() const;
     void SetLastChange(const FILETIME& t);
+    bool HasLastChange(const FILETIME& t) const; // Equal at the stored precision
     void SetAttributes(DWORD attr);
     DWORD GetAttributes() const;
+    void SetReparseTag(DWORD tag);
+    DWORD GetReparseTag() const;
     unsigned short GetSortAttributes() const;
     double GetFraction() const;
     bool IsRootItem() const;
+    bool IsOffline() const;
     std::wstring GetPath() const;
     std::wstring GetPathLong() const;
     std::wstring GetOwner(bool force = false) const;
+    void SetOwnerIndex(unsigned short index);
+    unsigned short GetOwnerIndex() const;
     bool HasUncPath() const;
     std::wstring GetFolderPath() const;
     std::wstring GetName() const;
     std::wstring GetExtension() const;
+    CExtensionTable::Id GetExtensionId() const;
     ULONG GetFilesCount() const;
     ULONG GetFoldersCount() const;
     ULONGLONG GetItemsCount() const;
@@ -205,7 +234,13 @@ public:
     void SortItemsBySizePhysical() const;
     ULONGLONG GetTicksWorked() const;
     void ResetScanStartTime() const;
+    void SetScanTime(ULONGLONG wall, ULONGLONG fileSystem) const;
+    ULONGLONG GetScanTime() const;
+    ULONGLONG GetScanFileSystemTime() const;
     static void ScanItems(BlockingQueue<CItem*> *);
+    static void BeginScanPass();
+    static void SetObserver(CScanObserver* observer);
+    bool IsScanPending() const;
     static void ScanItemsFinalize(CItem* item);
     void UpwardSetDone();
     void UpwardSetUndone();
@@ -254,9 +289,16 @@ private:
     bool MustShowReadJobs() const;
     COLORREF GetPercentageColor() const;
     std::wstring UpwardGetPathWithoutBackslash() const;
-    CItem* AddDirectory(const FileFindEnhanced& finder);
-    CItem* AddFile(const FileFindEnhanced& finder);
+    CItem* AddDirectory(const FileFindEnhanced& finder); // Links parent only, see AddChildren()
+    CItem* AddFile(const FileFindEnhanced& finder);      // Links parent only, see AddChildren()
+    static bool IsExcludedFromScan(const FileFindEnhanced& finder);
+    static bool IsFollowedDuringScan(const FileFindEnhanced& finder);
+    static void PushForScan(BlockingQueue<CItem*>* queue, CItem* item);
+    bool OpenForScan(FileFindEnhanced& finder, bool shareHandle);
+    bool ClaimScan();
     void UpwardDrivePacman();
+    void CountExtension(LONGLONG bytes, LONGLONG files) const;
+    CItemArena* GetArena() const;
 
     // Special structure for container items that is separately allocated to
     // reduce memory usage.  This operates under the assumption that most
@@ -270,15 +312,37 @@ private:
         std::atomic<ULONG> m_Files = 0;   // # Files in subtree
         std::atomic<ULONG> m_Subdirs = 0; // # Folder in subtree
         std::atomic<ULONG> m_Jobs = 0;    // # "read jobs" in subtree.
+        std::atomic<ULONG> m_ScanPass = 0; // Last scan pass that enumerated this node
+        std::atomic<ULONGLONG> m_ScanTime = 0;           // Microseconds spent enumerating this node itself
+        std::atomic<ULONGLONG> m_ScanFileSystemTime = 0; // Part of the above spent in file system calls
+    };
+
+    // Treemap coordinates are window pixels and fit in 16 bits
+    struct SRECT
+    {
+        short left, top, right, bottom;
     };
 
-    RECT m_Rect;                                // To support TreeMapView
-    std::wstring m_Name;                        // Display name
-    LPCWSTR m_Extension = nullptr;              // Cache of extension (it's used often)
-    FILETIME m_LastChange = {0, 0};             // Last modification time of self or subtree
+    // Last change times are kept in seconds since 1970 to fit in 32 bits
+    static ULONG ToItemTime(const FILETIME& t);
+    static FILETIME FromItemTime(ULONG t);
+
+    static inline std::atomic<ULONG> m_CurrentScanPass = 0; // Incremented for each run of the scanning engine
+    static inline CScanObserver* m_Observer = nullptr;      // Notified of tree changes; null when headless
+
+    friend class CItemArena;
+    static inline std::mutex m_RootArenasMutex;
+    static inline std::unordered_map<const CItem*, std::unique_ptr<CItemArena>> m_RootArenas; // Keyed by root item
+
+    SRECT m_Rect = {};                          // To support TreeMapView
+    LPCWSTR m_Name = nullptr;                   // Display name, see CItemArena
     CHILDINFO* m_FolderInfo = nullptr;          // Child information for non-files
     std::atomic<ULONGLONG> m_SizePhysical = 0;  // Total physical size of self or subtree
     std::atomic<ULONGLONG> m_SizeLogical = 0;   // Total local size of self or subtree
+    ULONG m_LastChange = 0;                     // Last modification time of self or subtree, see ToItemTime()
     DWORD m_Attributes = 0;                     // Packed file attributes of the item
+    CExtensionTable::Id m_ExtensionId = 0;      // Extension of files, see CExtensionTable
+    mutable std::atomic<DWORD> m_ReparseTag = 0; // Reparse tag if the item is a reparse point, see GetReparseTag()
     ITEMTYPE m_Type;                            // Indicates our type.
+    unsigned short m_OwnerIndex = 0;            // Owner in COwnerCache if already fetched
 };
@@ -0,0 +1,194 @@
+// ItemArena.cpp - Implementation of CItemArena
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#include "stdafx.h"
+#include "ItemArena.h"
+#include "Item.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+CItemArena::CItemArena() : m_Id(m_NextId++)
+{
+    m_Slabs[ItemSlab].SlotSize = sizeof(CItem);
+    m_Slabs[ChildInfoSlab].SlotSize = sizeof(CItem::CHILDINFO);
+}
+
+CItemArena::~CItemArena()
+{
+    // Destroy the items that are still alive in block order; items do not
+    // delete their children themselves so nothing recurses through the tree
+    m_Releasing = true;
+    for (const auto& block : m_Slabs[ItemSlab].Blocks)
+    {
+        for (size_t i = 0; i < block->Carved; i++)
+        {
+            const auto slot = SlotAt(block, i);
+            if ((*static_cast<std::uintptr_t*>(slot) & 1) == 0) static_cast<CItem*>(slot)->~CItem();
+        }
+    }
+
+    ULONGLONG blockBytes = m_NameBytes;
+    for (auto& slab : m_Slabs)
+    {
+        for (const auto& block : slab.Blocks)
+        {
+            VirtualFree(block, 0, MEM_RELEASE);
+        }
+        blockBytes += slab.Blocks.size() * BLOCK_SIZE;
+        m_FreeBytes -= slab.FreeCount * slab.SlotSize;
+    }
+    m_TotalBytes -= blockBytes;
+}
+
+CItemArena* CItemArena::Of(const void* slot)
+{
+    return reinterpret_cast<const BLOCK*>(reinterpret_cast<std::uintptr_t>(slot) & ~(BLOCK_SIZE - 1))->Arena;
+}
+
+void* CItemArena::SlotAt(const BLOCK* block, const size_t index)
+{
+    return reinterpret_cast<BYTE*>(const_cast<BLOCK*>(block)) + BLOCK_HEADER +
+        index * block->Arena->m_Slabs[block->Kind].SlotSize;
+}
+
+CItemArena::BLOCK* CItemArena::AddBlock(const Slab slab)
+{
+    // Reservations are aligned to the allocation granularity which is the block size,
+    // so the block of any slot is found by masking its address
+    const auto block = static_cast<BLOCK*>(VirtualAlloc(nullptr, BLOCK_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (block == nullptr) throw std::bad_alloc();
+    *block = { this, slab, 0 };
+
+    std::lock_guard lock(m_Mutex);
+    m_Slabs[slab].Blocks.push_back(block);
+    m_TotalBytes += BLOCK_SIZE;
+    return block;
+}
+
+CItemArena::CARVER* CItemArena::GetCarver()
+{
+    // Threads only remember the arena they allocated from last; the pointer
+    // is only used while the identifier still matches a live arena
+    thread_local std::pair<ULONGLONG, CARVER*> last;
+    if (last.first == m_Id) return last.second;
+
+    // Threads that switch between trees pick up their partly carved blocks again
+    const DWORD thread = GetCurrentThreadId();
+    std::lock_guard lock(m_Mutex);
+    const auto found = std::ranges::find(m_Carvers, thread, [](const auto& carver) { return carver->Thread; });
+    CARVER* carver = found != m_Carvers.end() ? found->get() :
+        m_Carvers.emplace_back(std::make_unique<CARVER>(thread)).get();
+    last = { m_Id, carver };
+    return carver;
+}
+
+void* CItemArena::AllocateSlot(const Slab slab)
+{
+    // Reuse the slots of removed items first
+    SLAB& state = m_Slabs[slab];
+    if (state.FreeCount.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard lock(m_Mutex);
+        if (const auto slot = state.FreeList; slot != nullptr)
+        {
+            state.FreeList = reinterpret_cast<void*>(*static_cast<std::uintptr_t*>(slot) & ~std::uintptr_t{ 1 });
+            --state.FreeCount;
+            m_FreeBytes -= state.SlotSize;
+            return slot;
+        }
+    }
+
+    // Each thread keeps carving the block it took last in this arena
+    BLOCK*& block = GetCarver()->Blocks[slab];
+    if (block == nullptr || block->Carved == (BLOCK_SIZE - BLOCK_HEADER) / state.SlotSize)
+    {
+        block = AddBlock(slab);
+    }
+    return SlotAt(block, block->Carved++);
+}
+
+void CItemArena::Free(void* slot)
+{
+    const auto block = reinterpret_cast<BLOCK*>(reinterpret_cast<std::uintptr_t>(slot) & ~(BLOCK_SIZE - 1));
+    CItemArena* arena = block->Arena;
+    if (arena->m_Releasing) return;
+
+    // Free slots are linked through their first word with the lowest bit set, which
+    // tells them apart from live items whose first word is an aligned vtable pointer
+    SLAB& state = arena->m_Slabs[block->Kind];
+    std::lock_guard lock(arena->m_Mutex);
+    *static_cast<std::uintptr_t*>(slot) = reinterpret_cast<std::uintptr_t>(state.FreeList) | 1;
+    state.FreeList = slot;
+    ++state.FreeCount;
+    m_FreeBytes += state.SlotSize;
+}
+
+CExtensionStatistics* CItemArena::GetExtensionStatistics(const void* slot)
+{
+    CItemArena* arena = Of(slot);
+    return arena->m_Releasing ? nullptr : &arena->m_ExtensionStatistics;
+}
+
+LPWSTR CItemArena::AllocateName(const size_t count)
+{
+    // Each thread keeps the remainder of the block it took last in this arena
+    CARVER* carver = GetCarver();
+    if (carver->NamesLeft >= count)
+    {
+        const LPWSTR result = carver->NamesNext;
+        carver->NamesNext += count;
+        carver->NamesLeft -= count;
+        return result;
+    }
+
+    // Names longer than a block get a block of their own
+    const size_t size = std::max(count, NAME_BLOCK_SIZE);
+    std::lock_guard lock(m_Mutex);
+    const LPWSTR memory = m_NameBlocks.emplace_back(std::make_unique_for_overwrite<WCHAR[]>(size)).get();
+    m_NameBytes += size * sizeof(WCHAR);
+    m_TotalBytes += size * sizeof(WCHAR);
+    if (size == NAME_BLOCK_SIZE)
+    {
+        carver->NamesNext = memory + count;
+        carver->NamesLeft = size - count;
+    }
+    return memory;
+}
+
+LPCWSTR CItemArena::StoreName(const std::wstring_view name)
+{
+    const LPWSTR copy = AllocateName(name.size() + 1);
+    std::ranges::copy(name, copy);
+    copy[name.size()] = L'\0';
+    return copy;
+}
+
+ULONGLONG CItemArena::GetTotalBytes()
+{
+    return m_TotalBytes;
+}
+
+ULONGLONG CItemArena::GetFreeBytes()
+{
+    return m_FreeBytes;
+}
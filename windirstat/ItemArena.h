@@ -0,0 +1,126 @@
+// ItemArena.h - Declaration of CItemArena
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#pragma once
+
+#include "ExtensionTable.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+//
+// CItemArena. Per-root storage for the items of a tree, their child
+// information and their names. Creating a root item creates an arena and
+// every other item is allocated from the arena of its parent, so a tree never
+// spans arenas and is released in bulk when its root is deleted instead of
+// item by item. Items and child
+// information live in fixed size slots of 64 KB blocks, and slots freed by
+// removing single items are reused through a free list. Names are appended
+// and only released with the arena. Threads carve from private blocks so the
+// arena lock is only taken when a block runs out. Each arena also keeps the
+// extension statistics of its tree.
+//
+class CItemArena final
+{
+public:
+    enum Slab : int
+    {
+        ItemSlab,      // CItem
+        ChildInfoSlab, // CItem::CHILDINFO
+        SlabCount
+    };
+
+    CItemArena();
+    ~CItemArena();
+
+    CItemArena(const CItemArena&) = delete;
+    CItemArena& operator=(const CItemArena&) = delete;
+
+    // Arena the slot was allocated from, found through the header of its block
+    static CItemArena* Of(const void* slot);
+
+    // Free() returns the slot to the arena it came from
+    void* AllocateSlot(Slab slab);
+    static void Free(void* slot);
+
+    // Copies the name into the arena and returns the terminated copy
+    LPCWSTR StoreName(std::wstring_view name);
+
+    // Bytes held by all arenas and the part of it in free slots
+    static ULONGLONG GetTotalBytes();
+    static ULONGLONG GetFreeBytes();
+
+    // Statistics of the tree the slot belongs to; null while its arena is torn down
+    static CExtensionStatistics* GetExtensionStatistics(const void* slot);
+    CExtensionStatistics& GetExtensionStatistics() { return m_ExtensionStatistics; }
+
+private:
+    struct BLOCK
+    {
+        CItemArena* Arena;
+        Slab Kind;
+        size_t Carved; // Slots handed out so far; only written by the thread carving the block
+    };
+
+    // Blocks a thread carves from; only used by that thread
+    struct CARVER
+    {
+        explicit CARVER(const DWORD thread) : Thread(thread) {}
+        const DWORD Thread;
+        std::array<BLOCK*, SlabCount> Blocks = {};
+        LPWSTR NamesNext = nullptr;
+        size_t NamesLeft = 0;
+    };
+
+    struct SLAB
+    {
+        size_t SlotSize = 0;
+        std::vector<BLOCK*> Blocks;
+        void* FreeList = nullptr;
+        std::atomic<size_t> FreeCount = 0;
+    };
+
+    LPWSTR AllocateName(size_t count);
+    CARVER* GetCarver();
+    BLOCK* AddBlock(Slab slab);
+    static void* SlotAt(const BLOCK* block, size_t index);
+
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;  // Allocation granularity, so blocks are aligned to their size
+    static constexpr size_t BLOCK_HEADER = 64;
+    static constexpr size_t NAME_BLOCK_SIZE = 32 * 1024; // Characters per name block
+
+    static inline std::atomic<ULONGLONG> m_NextId = 1;
+    static inline std::atomic<ULONGLONG> m_TotalBytes = 0;
+    static inline std::atomic<ULONGLONG> m_FreeBytes = 0;
+
+    const ULONGLONG m_Id; // Distinguishes arenas that reuse an address
+    std::mutex m_Mutex;
+    std::array<SLAB, SlabCount> m_Slabs;
+    std::vector<std::unique_ptr<WCHAR[]>> m_NameBlocks;
+    std::vector<std::unique_ptr<CARVER>> m_Carvers;
+    ULONGLONG m_NameBytes = 0;
+    CExtensionStatistics m_ExtensionStatistics;
+    bool m_Releasing = false; // Slots are not recycled while the arena is torn down
+};
@@ -0,0 +1,130 @@
+// ItemReclaimer.cpp - Implementation of CItemReclaimer
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#include "stdafx.h"
+#include "ItemReclaimer.h"
+#include "Item.h"
+#include "ItemDupe.h"
+#include "Options.h"
+
+CItemReclaimer* CItemReclaimer::Get()
+{
+    static CItemReclaimer reclaimer;
+    return &reclaimer;
+}
+
+CItemReclaimer::~CItemReclaimer()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Queued.notify_all();
+    if (m_Thread.joinable()) m_Thread.join();
+}
+
+void CItemReclaimer::Reclaim(CItem* item)
+{
+    if (item == nullptr) return;
+    Enqueue([item] { delete item; }, item->GetItemsCount() + 1);
+}
+
+void CItemReclaimer::Reclaim(std::vector<CItem*>&& items)
+{
+    if (items.empty()) return;
+
+    ULONGLONG count = 0;
+    for (const auto& item : items) count += item->GetItemsCount() + 1;
+    Enqueue([items = std::move(items)]
+    {
+        for (const auto& item : items) delete item;
+    }, count);
+}
+
+void CItemReclaimer::Reclaim(CItemDupe* item)
+{
+    if (item == nullptr) return;
+
+    // Duplicate entries do not delete their children themselves
+    Enqueue([item]
+    {
+        for (std::vector pending{ item }; !pending.empty();)
+        {
+            const auto next = pending.back();
+            pending.pop_back();
+            pending.insert(pending.end(), next->GetChildren().begin(), next->GetChildren().end());
+            delete next;
+        }
+    }, item->GetChildren().size() + 1);
+}
+
+void CItemReclaimer::Enqueue(std::function<void()>&& work, const ULONGLONG items)
+{
+    std::unique_lock lock(m_Mutex);
+    if (!m_Thread.joinable())
+    {
+        m_Thread = std::thread([this] { Run(); });
+        SetThreadPriority(m_Thread.native_handle(), THREAD_PRIORITY_LOWEST);
+    }
+
+    // Over the budget the previous trees are finished at normal priority first
+    if (m_Outstanding > 0 && m_PendingItems + items > static_cast<ULONGLONG>(COptions::ReclaimPendingItems))
+    {
+        SetThreadPriority(m_Thread.native_handle(), THREAD_PRIORITY_NORMAL);
+        m_Done.wait(lock, [this] { return m_Outstanding == 0; });
+        SetThreadPriority(m_Thread.native_handle(), THREAD_PRIORITY_LOWEST);
+    }
+
+    m_Pending.push_back({ std::move(work), items });
+    m_PendingItems += items;
+    m_Outstanding++;
+    m_Queued.notify_one();
+}
+
+void CItemReclaimer::Drain()
+{
+    std::unique_lock lock(m_Mutex);
+    if (m_Outstanding == 0 || std::this_thread::get_id() == m_Thread.get_id()) return;
+
+    SetThreadPriority(m_Thread.native_handle(), THREAD_PRIORITY_NORMAL);
+    m_Done.wait(lock, [this] { return m_Outstanding == 0; });
+    SetThreadPriority(m_Thread.native_handle(), THREAD_PRIORITY_LOWEST);
+}
+
+void CItemReclaimer::Run()
+{
+    std::unique_lock lock(m_Mutex);
+    while (true)
+    {
+        m_Queued.wait(lock, [this] { return m_Stopping || !m_Pending.empty(); });
+        if (m_Pending.empty()) return;
+
+        PENDING pending = std::move(m_Pending.front());
+        m_Pending.pop_front();
+        lock.unlock();
+        pending.Work();
+        lock.lock();
+
+        m_PendingItems -= pending.Items;
+        m_Outstanding--;
+        m_Done.notify_all();
+    }
+}
@@ -0,0 +1,77 @@
+// ItemReclaimer.h - Declaration of CItemReclaimer
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CItem;
+class CItemDupe;
+
+//
+// CItemReclaimer. Deletes discarded trees on a low priority thread so a new
+// scan or a loaded snapshot does not wait for the old tree to be freed. Work
+// is done in the order it was queued. Once more items are pending than
+// COptions::ReclaimPendingItems allows, queuing waits for the thread to catch
+// up so no more than about one discarded tree is held at a time.
+//
+class CItemReclaimer final
+{
+public:
+    CItemReclaimer(const CItemReclaimer&) = delete;
+    CItemReclaimer& operator=(const CItemReclaimer&) = delete;
+    ~CItemReclaimer();
+
+    static CItemReclaimer* Get();
+
+    // Take ownership of the items and their subtrees; null is ignored
+    void Reclaim(CItem* item);
+    void Reclaim(std::vector<CItem*>&& items);
+    void Reclaim(CItemDupe* item);
+
+    // Waits until everything queued so far has been deleted
+    void Drain();
+
+private:
+    CItemReclaimer() = default;
+    void Enqueue(std::function<void()>&& work, ULONGLONG items);
+    void Run();
+
+    struct PENDING
+    {
+        std::function<void()> Work;
+        ULONGLONG Items;
+    };
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Queued;
+    std::condition_variable m_Done;
+    std::deque<PENDING> m_Pending;
+    ULONGLONG m_PendingItems = 0; // Items queued or being deleted
+    size_t m_Outstanding = 0;     // Work queued or in progress
+    bool m_Stopping = false;
+    std::thread m_Thread;
+};
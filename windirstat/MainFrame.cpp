@@ -35,6 +35,7 @@
 #include "PageFileTree.h"
 #include "PageTreeMap.h"
 #include "PageGeneral.h"
+#include "ScanStatistics.h"
 #include "MainFrame.h"
 #include "SelectObject.h"
 #include <CommonHelpers.h>
@@ -378,14 +379,16 @@ END_MESSAGE_MAP()
 
 constexpr auto ID_INDICATOR_IDLEMESSAGE_INDEX = 0;
 constexpr auto ID_INDICATOR_MEMORYUSAGE_INDEX = 1;
-constexpr auto ID_INDICATOR_CAPS_INDEX = 2;
-constexpr auto ID_INDICATOR_NUM_INDEX = 3;
-constexpr auto ID_INDICATOR_SCRL_INDEX = 4;
+constexpr auto ID_INDICATOR_SCANSTATISTICS_INDEX = 2;
+constexpr auto ID_INDICATOR_CAPS_INDEX = 3;
+constexpr auto ID_INDICATOR_NUM_INDEX = 4;
+constexpr auto ID_INDICATOR_SCRL_INDEX = 5;
 
 constexpr UINT indicators[]
 {
     IDS_IDLEMESSAGE,
     IDS_RAMUSAGEs,
+    IDS_SCANSTATISTICSsssss,
     ID_INDICATOR_CAPS,
     ID_INDICATOR_NUM,
     ID_INDICATOR_SCRL,
@@ -463,6 +466,9 @@ void CMainFrame::SetProgressComplete() // called by CDirStatDoc
     DestroyProgress();
     CDirStatDoc::GetDocument()->SetTitlePrefix(wds::strEmpty);
     SetMessageText(Localization::Lookup(IDS_IDLEMESSAGE));
+
+    // Short scans may finish between timer updates; show the final scan cache figures
+    SetStatusPaneText(ID_INDICATOR_SCANSTATISTICS_INDEX, CScanStatistics::Get()->GetStatusText());
     CFileTreeControl::Get()->SortItems();
 }
 
@@ -625,6 +631,10 @@ int CMainFrame::OnCreate(LPCREATESTRUCT lpCreateStruct)
     SetStatusPaneText(ID_INDICATOR_SCRL_INDEX, Localization::Lookup(IDS_INDICATOR_SCRL));
     SetStatusPaneText(ID_INDICATOR_MEMORYUSAGE_INDEX, CDirStatApp::GetCurrentProcessMemoryInfo());
 
+    // Scan throughput is only shown once a scan is running
+    m_WndStatusBar.SetPaneText(ID_INDICATOR_SCANSTATISTICS_INDEX, L"");
+    m_WndStatusBar.SetPaneWidth(ID_INDICATOR_SCANSTATISTICS_INDEX, 0);
+
     m_WndDeadFocus.Create(this);
 
     m_WndToolBar.EnableDocking(CBRS_ALIGN_ANY);
@@ -826,10 +836,23 @@ void CMainFrame::OnTimer(const UINT_PTR nIDEvent)
         // Update memory usage
         SetStatusPaneText(ID_INDICATOR_MEMORYUSAGE_INDEX, CDirStatApp::GetCurrentProcessMemoryInfo());
 
+        // Update scan throughput; the last figures stay visible once the scan is done
+        if (!CDirStatDoc::GetDocument()->IsRootDone() && !IsScanSuspended())
+        {
+            SetStatusPaneText(ID_INDICATOR_SCANSTATISTICS_INDEX, CScanStatistics::Get()->GetStatusText());
+        }
+
         // Force toolbar updates since they do not appear to always receive onidle commands
         m_WndToolBar.OnUpdateCmdUI(this, FALSE);
     }
 
+    // Apply file system changes to the finished tree about once a second
+    if (updateCounter % 40 == 0 && !IsScanSuspended())
+    {
+        CDirStatDoc::GetDocument()->RefreshWatchedChanges();
+        CDirStatDoc::GetDocument()->RevalidateScanCache();
+    }
+
     // UI updates that do need to processed frequently
     if (!CDirStatDoc::GetDocument()->IsRootDone() && !IsScanSuspended())
     {
@@ -839,6 +862,12 @@ void CMainFrame::OnTimer(const UINT_PTR nIDEvent)
         // By sorting items, items will be redrawn which will
         // also force pacman to update with recent position
         CFileTreeControl::Get()->SortItems();
+
+        // Show the extension statistics gathered so far about once a second
+        if (updateCounter % 40 == 0 && GetExtensionView()->IsShowTypes())
+        {
+            CDirStatDoc::GetDocument()->RefreshExtensionData();
+        }
     }
 
     CFrameWndEx::OnTimer(nIDEvent);
@@ -0,0 +1,392 @@
+// MftDecoder.cpp
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "MftDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <ranges>
+
+namespace
+{
+    constexpr std::uint32_t ATTR_STANDARD_INFORMATION = 0x10;
+    constexpr std::uint32_t ATTR_ATTRIBUTE_LIST = 0x20;
+    constexpr std::uint32_t ATTR_FILE_NAME = 0x30;
+    constexpr std::uint32_t ATTR_VOLUME_NAME = 0x60;
+    constexpr std::uint32_t ATTR_DATA = 0x80;
+    constexpr std::uint32_t ATTR_END = 0xFFFFFFFF;
+
+    constexpr std::uint16_t ATTR_FLAG_COMPRESSED = 0x0001;
+    constexpr std::uint16_t ATTR_FLAG_SPARSE = 0x8000;
+    constexpr std::uint16_t RECORD_IN_USE = 0x0001;
+    constexpr std::uint16_t RECORD_IS_DIRECTORY = 0x0002;
+    constexpr std::uint8_t NAMESPACE_DOS = 2;
+    constexpr std::uint32_t ATTRIBUTE_DIRECTORY = 0x10; // FILE_ATTRIBUTE_DIRECTORY
+
+    // Unaligned little endian field access into a record buffer
+    template <typename T> T Get(const std::uint8_t* p)
+    {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+    template <typename Callback>
+    void ForEachAttribute(const std::uint8_t* record, const std::uint32_t size, Callback callback)
+    {
+        const std::uint32_t used = std::min(Get<std::uint32_t>(record + 0x18), size);
+        for (std::uint32_t offset = Get<std::uint16_t>(record + 0x14); offset + 0x10 <= used;)
+        {
+            const std::uint8_t* attr = record + offset;
+            const auto type = Get<std::uint32_t>(attr);
+            const auto length = Get<std::uint32_t>(attr + 0x04);
+            if (type == ATTR_END || length < 0x10 || offset + length > used) break;
+
+            callback(type, attr, length);
+            offset += length;
+        }
+    }
+
+    const std::uint8_t* ResidentValue(const std::uint8_t* attr, const std::uint32_t length, std::uint32_t& valueLength)
+    {
+        if (attr[0x08] != 0 || length < 0x18) return nullptr;
+        valueLength = Get<std::uint32_t>(attr + 0x10);
+        const auto valueOffset = Get<std::uint16_t>(attr + 0x14);
+        return valueOffset + valueLength <= length ? attr + valueOffset : nullptr;
+    }
+
+    // Decodes a non-resident runlist into cluster / count pairs; sparse runs have cluster zero
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ParseRunList(const std::uint8_t* attr, const std::uint32_t length)
+    {
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> runs;
+        std::int64_t lcn = 0;
+        for (std::uint32_t offset = Get<std::uint16_t>(attr + 0x20); offset < length && attr[offset] != 0;)
+        {
+            const std::uint32_t lengthBytes = attr[offset] & 0x0F;
+            const std::uint32_t offsetBytes = attr[offset] >> 4;
+            if (lengthBytes == 0 || lengthBytes > 8 || offsetBytes > 8 ||
+                offset + 1 + lengthBytes + offsetBytes > length) break;
+
+            std::uint64_t count = 0;
+            std::memcpy(&count, attr + offset + 1, lengthBytes);
+
+            // Cluster offsets are signed and relative to the previous run
+            std::int64_t delta = 0;
+            std::memcpy(&delta, attr + offset + 1 + lengthBytes, offsetBytes);
+            if (offsetBytes > 0 && offsetBytes < 8 && (attr[offset + lengthBytes + offsetBytes] & 0x80) != 0)
+            {
+                delta |= static_cast<std::int64_t>(~0ull << (offsetBytes * 8));
+            }
+
+            lcn += delta;
+            runs.emplace_back(offsetBytes > 0 ? lcn : 0, count);
+            offset += 1 + lengthBytes + offsetBytes;
+        }
+
+        return runs;
+    }
+}
+
+bool MftApplyFixups(std::uint8_t* record, const std::uint32_t size)
+{
+    if (std::memcmp(record, "FILE", 4) != 0) return false;
+
+    const auto usaOffset = Get<std::uint16_t>(record + 0x04);
+    const auto usaCount = Get<std::uint16_t>(record + 0x06);
+    if (usaCount < 2 || usaOffset + usaCount * sizeof(std::uint16_t) > size) return false;
+
+    const std::uint32_t stride = size / (usaCount - 1);
+    const std::uint8_t* usa = record + usaOffset;
+    for (std::uint32_t i = 1; i < usaCount; i++)
+    {
+        std::uint8_t* tail = record + i * stride - sizeof(std::uint16_t);
+        if (std::memcmp(tail, usa, sizeof(std::uint16_t)) != 0) return false;
+        std::memcpy(tail, usa + i * sizeof(std::uint16_t), sizeof(std::uint16_t));
+    }
+
+    return true;
+}
+
+std::uint64_t MftParseRecord(const std::uint8_t* record, const std::uint32_t size, MftRecord& info, bool& hasData)
+{
+    const auto flags = Get<std::uint16_t>(record + 0x16);
+    info.Sequence = Get<std::uint16_t>(record + 0x10);
+    info.InUse = (flags & RECORD_IN_USE) != 0;
+    info.IsDirectory = (flags & RECORD_IS_DIRECTORY) != 0;
+    hasData = false;
+    if (!info.InUse) return 0;
+
+    // Attribute lists only reference attributes that live in extension records, and
+    // those records point back at their base, so they are merged from that side
+    ForEachAttribute(record, size, [&](const std::uint32_t type, const std::uint8_t* attr, const std::uint32_t length)
+    {
+        std::uint32_t valueLength = 0;
+        if (type == ATTR_STANDARD_INFORMATION)
+        {
+            if (const std::uint8_t* value = ResidentValue(attr, length, valueLength); value != nullptr && valueLength >= 0x24)
+            {
+                info.LastChange = Get<std::uint64_t>(value + 0x08);
+                info.Attributes = Get<std::uint32_t>(value + 0x20);
+            }
+        }
+        else if (type == ATTR_FILE_NAME)
+        {
+            const std::uint8_t* value = ResidentValue(attr, length, valueLength);
+            if (value == nullptr || valueLength < 0x42) return;
+
+            // Short names are only aliases of a long name in the same directory
+            const std::uint8_t nameLength = value[0x40];
+            if (value[0x41] == NAMESPACE_DOS || 0x42 + nameLength * sizeof(char16_t) > valueLength) return;
+
+            std::wstring name(nameLength, L'\0');
+            for (std::uint8_t c = 0; c < nameLength; c++) name[c] = Get<char16_t>(value + 0x42 + c * sizeof(char16_t));
+            info.Names.push_back({ Get<std::uint64_t>(value), std::move(name) });
+
+            // Reparse points keep their tag where other files keep their extended attribute size
+            info.ReparseTag = Get<std::uint32_t>(value + 0x3C);
+        }
+        else if (type == ATTR_DATA && attr[0x09] == 0)
+        {
+            if (attr[0x08] == 0)
+            {
+                if (ResidentValue(attr, length, valueLength) == nullptr) return;
+                info.SizeLogical = valueLength;
+                info.SizePhysical = 0;
+                hasData = true;
+            }
+            else if (length >= 0x40 && Get<std::uint64_t>(attr + 0x10) == 0)
+            {
+                // Only the first fragment of a split stream carries the sizes
+                const bool compressed = (Get<std::uint16_t>(attr + 0x0C) & (ATTR_FLAG_COMPRESSED | ATTR_FLAG_SPARSE)) != 0;
+                info.SizeLogical = Get<std::uint64_t>(attr + 0x30);
+                info.SizePhysical = Get<std::uint64_t>(attr + (compressed && length >= 0x48 ? 0x40 : 0x28));
+                hasData = true;
+            }
+        }
+    });
+
+    if (info.IsDirectory) info.Attributes |= ATTRIBUTE_DIRECTORY;
+    return Get<std::uint64_t>(record + 0x20) & MFT_REF_MASK;
+}
+
+void MftDecodeRecords(std::uint8_t* buffer, const std::size_t size, const std::uint32_t recordSize, const std::uint64_t firstRecord,
+    std::vector<MftRecord>& records, std::vector<MftExtension>& extensions)
+{
+    for (std::size_t i = 0; i < size / recordSize && firstRecord + i < records.size(); i++)
+    {
+        std::uint8_t* record = buffer + i * recordSize;
+        if (!MftApplyFixups(record, recordSize)) continue;
+
+        MftRecord info;
+        bool hasData = false;
+        if (const std::uint64_t base = MftParseRecord(record, recordSize, info, hasData); base == 0)
+        {
+            records[firstRecord + i] = std::move(info);
+        }
+        else if (info.InUse && base < records.size())
+        {
+            extensions.push_back({ base, std::move(info), hasData });
+        }
+    }
+}
+
+void MftMergeExtensions(std::vector<MftRecord>& records, std::vector<MftExtension>& extensions)
+{
+    for (auto& [base, info, hasData] : extensions)
+    {
+        auto& target = records[base];
+        std::ranges::move(info.Names, std::back_inserter(target.Names));
+        if (!hasData) continue;
+        target.SizeLogical = info.SizeLogical;
+        target.SizePhysical = info.SizePhysical;
+    }
+    extensions.clear();
+}
+
+bool MftParseLayout(const std::uint8_t* header, const std::size_t size, MftLayout& layout)
+{
+    layout = {};
+    if (size < 0x50) return false;
+
+    if (std::memcmp(header, "FILE", 4) == 0)
+    {
+        layout.RecordSize = Get<std::uint32_t>(header + 0x1C);
+        return layout.RecordSize >= 512 && layout.RecordSize <= 65536 && (layout.RecordSize & (layout.RecordSize - 1)) == 0;
+    }
+
+    if (std::memcmp(header + 3, "NTFS    ", 8) != 0) return false;
+    layout.Serial = Get<std::uint64_t>(header + 0x48);
+
+    // Decode the volume geometry from the boot sector
+    layout.SectorSize = Get<std::uint16_t>(header + 0x0B);
+    const std::uint8_t sectorsPerCluster = header[0x0D];
+    layout.ClusterSize = layout.SectorSize * (sectorsPerCluster <= 0x80 ? sectorsPerCluster : 1u << (256 - sectorsPerCluster));
+    const auto clustersPerRecord = static_cast<std::int8_t>(header[0x40]);
+    layout.RecordSize = clustersPerRecord > 0 ? clustersPerRecord * layout.ClusterSize : 1u << -clustersPerRecord;
+    layout.MftOffset = Get<std::uint64_t>(header + 0x30) * layout.ClusterSize;
+    return layout.ClusterSize != 0 && layout.RecordSize >= 512 && layout.RecordSize <= 65536;
+}
+
+void MftCollectDataRuns(const std::uint8_t* record, const std::uint32_t recordSize, MftDataRuns& runs)
+{
+    ForEachAttribute(record, recordSize, [&](const std::uint32_t type, const std::uint8_t* attr, const std::uint32_t length)
+    {
+        if (type == ATTR_DATA && attr[0x08] != 0 && attr[0x09] == 0 && length >= 0x40)
+        {
+            const auto vcn = Get<std::uint64_t>(attr + 0x10);
+            if (vcn == 0) runs.DataSize = Get<std::uint64_t>(attr + 0x30);
+            runs.Fragments[vcn] = ParseRunList(attr, length);
+        }
+        else if (type == ATTR_ATTRIBUTE_LIST)
+        {
+            // A very fragmented table continues its runlist in extension records
+            std::uint32_t valueLength = 0;
+            const std::uint8_t* value = ResidentValue(attr, length, valueLength);
+            for (std::uint32_t offset = 0; value != nullptr && offset + 0x1A <= valueLength;)
+            {
+                const auto entryLength = Get<std::uint16_t>(value + offset + 0x04);
+                const auto reference = Get<std::uint64_t>(value + offset + 0x10) & MFT_REF_MASK;
+                if (entryLength == 0) break;
+                if (Get<std::uint32_t>(value + offset) == ATTR_DATA && reference != 0) runs.ExtensionRecords.push_back(reference);
+                offset += entryLength;
+            }
+        }
+    });
+}
+
+std::vector<MftExtent> MftBuildExtents(const MftDataRuns& runs, const std::uint32_t clusterSize, const std::uint32_t recordSize)
+{
+    std::vector<MftExtent> extents;
+    std::uint64_t vcn = 0;
+    for (const auto& fragment : runs.Fragments | std::views::values) for (const auto& [lcn, count] : fragment)
+    {
+        if (lcn != 0) extents.push_back({ lcn * clusterSize, vcn * clusterSize / recordSize, count * clusterSize / recordSize });
+        vcn += count;
+    }
+
+    // Runs are allocated in whole clusters; ignore the slack past the end of the table
+    const std::uint64_t total = runs.DataSize / recordSize;
+    std::erase_if(extents, [&](const MftExtent& extent) { return extent.FirstRecord >= total; });
+    for (auto& extent : extents) extent.Records = std::min(extent.Records, total - extent.FirstRecord);
+    return extents;
+}
+
+bool MftFindRecordOffset(const std::vector<MftExtent>& extents, const std::uint64_t record, const std::uint32_t recordSize, std::uint64_t& offset)
+{
+    for (const auto& extent : extents)
+    {
+        if (record < extent.FirstRecord || record >= extent.FirstRecord + extent.Records) continue;
+        offset = extent.Offset + (record - extent.FirstRecord) * recordSize;
+        return true;
+    }
+    return false;
+}
+
+std::wstring MftVolumeLabel(const std::uint8_t* record, const std::uint32_t size)
+{
+    std::wstring label;
+    ForEachAttribute(record, size, [&](const std::uint32_t type, const std::uint8_t* attr, const std::uint32_t length)
+    {
+        std::uint32_t valueLength = 0;
+        const std::uint8_t* value = type == ATTR_VOLUME_NAME ? ResidentValue(attr, length, valueLength) : nullptr;
+        if (value == nullptr) return;
+        label.resize(valueLength / sizeof(char16_t));
+        for (std::size_t c = 0; c < label.size(); c++) label[c] = Get<char16_t>(value + c * sizeof(char16_t));
+    });
+    return label;
+}
+
+std::vector<MftNode> MftBuildTree(const std::vector<MftRecord>& records)
+{
+    std::vector<MftNode> nodes;
+    const std::uint64_t totalRecords = records.size();
+    if (totalRecords <= MFT_RECORD_ROOT) return nodes;
+
+    // Group every name under its parent directory; a stale parent reference
+    // (sequence mismatch) means the entry belongs to a deleted directory
+    const auto isLinked = [&](const std::uint64_t ref)
+    {
+        const std::uint64_t parent = ref & MFT_REF_MASK;
+        return parent < totalRecords && records[parent].InUse && records[parent].IsDirectory &&
+            records[parent].Sequence == static_cast<std::uint16_t>(ref >> 48);
+    };
+    std::vector<std::uint32_t> childStart(totalRecords + 1, 0);
+    for (std::uint32_t r = MFT_RECORD_FIRST_USER; r < totalRecords; r++)
+    {
+        if (!records[r].InUse) continue;
+        for (const auto& name : records[r].Names)
+        {
+            if (isLinked(name.Parent)) childStart[name.Parent & MFT_REF_MASK]++;
+        }
+    }
+    for (std::uint64_t r = 0, sum = 0; r <= totalRecords; r++)
+    {
+        const std::uint32_t count = r < totalRecords ? childStart[r] : 0;
+        childStart[r] = static_cast<std::uint32_t>(sum);
+        sum += count;
+    }
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> childLinks(childStart[totalRecords]);
+    {
+        std::vector<std::uint32_t> fill(childStart.begin(), childStart.end() - 1);
+        for (std::uint32_t r = MFT_RECORD_FIRST_USER; r < totalRecords; r++)
+        {
+            if (!records[r].InUse) continue;
+            for (std::uint32_t n = 0; n < records[r].Names.size(); n++)
+            {
+                const std::uint64_t ref = records[r].Names[n].Parent;
+                if (isLinked(ref)) childLinks[fill[ref & MFT_REF_MASK]++] = { r, n };
+            }
+        }
+    }
+
+    // Breadth first from the root so parents always precede their children
+    std::vector<bool> visited(totalRecords, false);
+    nodes.push_back({ MFT_RECORD_ROOT, 0, 0, 0, 0, records[MFT_RECORD_ROOT].LastChange, 0, 0 });
+    visited[MFT_RECORD_ROOT] = true;
+    for (std::size_t i = 0; i < nodes.size(); i++)
+    {
+        const std::uint32_t record = nodes[i].Record;
+        for (std::uint32_t c = childStart[record]; c < childStart[record + 1]; c++)
+        {
+            const auto [child, name] = childLinks[c];
+            const auto& info = records[child];
+            if (info.IsDirectory && visited[child]) continue;
+            visited[child] = true;
+            nodes.push_back({ child, name, i, info.SizeLogical, info.SizePhysical, info.LastChange, 0, 0 });
+        }
+    }
+
+    // Accumulate the subtree totals from the leaves upward
+    for (std::size_t i = nodes.size() - 1; i > 0; i--)
+    {
+        const MftNode& node = nodes[i];
+        MftNode& parent = nodes[node.Parent];
+        const bool isDirectory = records[node.Record].IsDirectory;
+        parent.SizeLogical += node.SizeLogical;
+        parent.SizePhysical += node.SizePhysical;
+        parent.Files += node.Files + (isDirectory ? 0 : 1);
+        parent.Folders += node.Folders + (isDirectory ? 1 : 0);
+        parent.LastChange = std::max(parent.LastChange, node.LastChange);
+    }
+
+    return nodes;
+}
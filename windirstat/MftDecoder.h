@@ -0,0 +1,138 @@
+// MftDecoder.h
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// Decoding of NTFS master file table structures held in memory. Nothing here
+// performs I/O: LoadMft reads the bytes and the functions below interpret
+// them, so each step can be fed from a fixture.
+//
+
+constexpr std::uint64_t MFT_REF_MASK = 0x0000FFFFFFFFFFFFull;
+constexpr std::uint32_t MFT_RECORD_VOLUME = 3;
+constexpr std::uint32_t MFT_RECORD_ROOT = 5;
+constexpr std::uint32_t MFT_RECORD_FIRST_USER = 16;
+
+struct MftName
+{
+    std::uint64_t Parent; // Parent reference including its sequence number
+    std::wstring Name;
+};
+
+struct MftRecord
+{
+    std::vector<MftName> Names;
+    std::uint64_t SizeLogical = 0;
+    std::uint64_t SizePhysical = 0;
+    std::uint64_t LastChange = 0; // FILETIME ticks
+    std::uint32_t Attributes = 0;
+    std::uint32_t ReparseTag = 0;
+    std::uint16_t Sequence = 0;
+    bool InUse = false;
+    bool IsDirectory = false;
+};
+
+// Attributes found in an extension record that belong to another base record
+struct MftExtension
+{
+    std::uint64_t Base;
+    MftRecord Record;
+    bool HasData;
+};
+
+// A contiguous range of records within the source file
+struct MftExtent
+{
+    std::uint64_t Offset;
+    std::uint64_t FirstRecord;
+    std::uint64_t Records;
+};
+
+// Where the records live, as told by the first bytes of the source
+struct MftLayout
+{
+    std::uint32_t RecordSize = 0;
+    std::uint32_t SectorSize = 0;
+    std::uint32_t ClusterSize = 0; // Zero for a $MFT extract
+    std::uint64_t MftOffset = 0;   // Byte offset of the $MFT record on a volume
+    std::uint64_t Serial = 0;      // Volume serial number from the boot sector
+};
+
+// The fragments of the $DATA attribute of $MFT, keyed by their starting cluster
+struct MftDataRuns
+{
+    std::map<std::uint64_t, std::vector<std::pair<std::uint64_t, std::uint64_t>>> Fragments;
+    std::vector<std::uint64_t> ExtensionRecords; // Records that continue the runlist
+    std::uint64_t DataSize = 0;
+};
+
+// One entry of the directory tree; parents always precede their children
+struct MftNode
+{
+    std::uint32_t Record;
+    std::uint32_t Name; // Index into the names of the record
+    std::size_t Parent;
+    std::uint64_t SizeLogical;
+    std::uint64_t SizePhysical;
+    std::uint64_t LastChange;
+    std::uint32_t Files;
+    std::uint32_t Folders;
+};
+
+// Validates the record signature and undoes the update sequence that
+// protects the last two bytes of every sector
+bool MftApplyFixups(std::uint8_t* record, std::uint32_t size);
+
+// Decodes one fixed up FILE record and returns its base record number, which is zero for base records
+std::uint64_t MftParseRecord(const std::uint8_t* record, std::uint32_t size, MftRecord& info, bool& hasData);
+
+// Decodes the records of a chunk in place; base records go to their slot and
+// extension records are appended for MftMergeExtensions
+void MftDecodeRecords(std::uint8_t* buffer, std::size_t size, std::uint32_t recordSize, std::uint64_t firstRecord,
+    std::vector<MftRecord>& records, std::vector<MftExtension>& extensions);
+
+// Folds attributes that spilled into extension records into their base records
+void MftMergeExtensions(std::vector<MftRecord>& records, std::vector<MftExtension>& extensions);
+
+// Recognizes either a $MFT extract or an NTFS boot sector
+bool MftParseLayout(const std::uint8_t* header, std::size_t size, MftLayout& layout);
+
+// Collects the $DATA fragments and attribute list references of a fixed up $MFT record
+void MftCollectDataRuns(const std::uint8_t* record, std::uint32_t recordSize, MftDataRuns& runs);
+
+// Maps the collected runs to record extents, ignoring the slack past the end of the table
+std::vector<MftExtent> MftBuildExtents(const MftDataRuns& runs, std::uint32_t clusterSize, std::uint32_t recordSize);
+
+bool MftFindRecordOffset(const std::vector<MftExtent>& extents, std::uint64_t record, std::uint32_t recordSize, std::uint64_t& offset);
+
+// Returns the $VOLUME_NAME of a fixed up $Volume record
+std::wstring MftVolumeLabel(const std::uint8_t* record, std::uint32_t size);
+
+// Links every name to its parent directory and walks breadth first from the
+// root, accumulating the subtree totals
+std::vector<MftNode> MftBuildTree(const std::vector<MftRecord>& records);
@@ -0,0 +1,221 @@
+// MftLoader.cpp
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "Item.h"
+#include "MftDecoder.h"
+#include "MftLoader.h"
+#include "MountPoints.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr ULONG MFT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    class MftFile final
+    {
+        HANDLE m_Handle;
+
+    public:
+        MftFile(const MftFile&) = delete;
+        MftFile& operator=(const MftFile&) = delete;
+
+        explicit MftFile(const std::wstring& path) : m_Handle(CreateFile(path.c_str(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)) {}
+
+        ~MftFile()
+        {
+            if (m_Handle != INVALID_HANDLE_VALUE) CloseHandle(m_Handle);
+        }
+
+        bool IsOpen() const
+        {
+            return m_Handle != INVALID_HANDLE_VALUE;
+        }
+
+        ULONGLONG GetSize() const
+        {
+            LARGE_INTEGER size;
+            return GetFileSizeEx(m_Handle, &size) ? size.QuadPart : 0;
+        }
+
+        // Positional read so several workers can share one source
+        DWORD Read(const ULONGLONG offset, void* buffer, const DWORD size) const
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD read = 0;
+            return ReadFile(m_Handle, buffer, size, &read, &overlapped) ? read : 0;
+        }
+    };
+
+    // Reads one record of the table and undoes its update sequence
+    bool ReadRecord(const MftFile& file, const std::vector<MftExtent>& extents, const ULONGLONG record,
+        const ULONG recordSize, std::vector<BYTE>& buffer)
+    {
+        ULONGLONG offset = 0;
+        buffer.resize(recordSize);
+        return MftFindRecordOffset(extents, record, recordSize, offset) &&
+            file.Read(offset, buffer.data(), recordSize) == recordSize &&
+            MftApplyFixups(buffer.data(), recordSize);
+    }
+
+    // Determines the record size and where the records are stored: either back to
+    // back in a $MFT extract or scattered over a volume as described by $MFT's own $DATA
+    bool LocateMft(const MftFile& file, MftLayout& layout, std::vector<MftExtent>& extents)
+    {
+        std::vector<BYTE> boot(4096);
+        if (file.Read(0, boot.data(), static_cast<DWORD>(boot.size())) != boot.size() ||
+            !MftParseLayout(boot.data(), boot.size(), layout)) return false;
+
+        if (layout.ClusterSize == 0)
+        {
+            extents.push_back({ 0, 0, file.GetSize() / layout.RecordSize });
+            return true;
+        }
+
+        // Read the $MFT record itself, the first record of the table
+        std::vector<BYTE> record(std::max(layout.RecordSize, layout.SectorSize));
+        if (file.Read(layout.MftOffset, record.data(), static_cast<DWORD>(record.size())) != record.size() ||
+            !MftApplyFixups(record.data(), layout.RecordSize)) return false;
+
+        MftDataRuns runs;
+        MftCollectDataRuns(record.data(), layout.RecordSize, runs);
+        extents = MftBuildExtents(runs, layout.ClusterSize, layout.RecordSize);
+
+        for (const auto extension : std::vector(runs.ExtensionRecords))
+        {
+            if (ReadRecord(file, extents, extension, layout.RecordSize, record))
+            {
+                MftCollectDataRuns(record.data(), layout.RecordSize, runs);
+            }
+        }
+        extents = MftBuildExtents(runs, layout.ClusterSize, layout.RecordSize);
+        return !extents.empty();
+    }
+
+    // Names the root so the paths of the tree stay meaningful: the volume
+    // itself for device paths and a label that is no path for images
+    std::wstring GetRootName(const std::wstring& path, const MftFile& file,
+        const std::vector<MftExtent>& extents, const MftLayout& layout, bool& offline)
+    {
+        offline = !(path.size() == 6 && path.starts_with(L"\\\\.\\") && iswalpha(path[4]) && path[5] == L':');
+        if (!offline) return path.substr(4, 2) + L"\\";
+
+        std::vector<BYTE> record;
+        if (ReadRecord(file, extents, MFT_RECORD_VOLUME, layout.RecordSize, record))
+        {
+            if (std::wstring label = MftVolumeLabel(record.data(), layout.RecordSize); !label.empty()) return label;
+        }
+
+        const auto serial = static_cast<ULONG>(layout.Serial);
+        if (serial != 0) return std::format(L"{:04X}-{:04X}", serial >> 16, serial & 0xFFFF);
+        return std::filesystem::path(path).filename().wstring();
+    }
+
+    FILETIME ToFileTime(const ULONGLONG ticks)
+    {
+        return { static_cast<DWORD>(ticks), static_cast<DWORD>(ticks >> 32) };
+    }
+}
+
+CItem* LoadMft(const std::wstring& path)
+{
+    const MftFile source(path);
+    if (!source.IsOpen()) return nullptr;
+
+    MftLayout layout;
+    std::vector<MftExtent> extents;
+    if (!LocateMft(source, layout, extents)) return nullptr;
+    const ULONG recordSize = layout.RecordSize;
+
+    bool offline = true;
+    const std::wstring rootName = GetRootName(path, source, extents, layout, offline);
+
+    // Split the table into independently readable chunks
+    std::vector<MftExtent> chunks;
+    ULONGLONG totalRecords = 0;
+    const ULONGLONG chunkRecords = std::max<ULONGLONG>(MFT_CHUNK_SIZE / recordSize, 1);
+    for (const auto& extent : extents)
+    {
+        for (ULONGLONG i = 0; i < extent.Records; i += chunkRecords)
+        {
+            chunks.push_back({ extent.Offset + i * recordSize, extent.FirstRecord + i, std::min(chunkRecords, extent.Records - i) });
+        }
+        totalRecords = std::max(totalRecords, extent.FirstRecord + extent.Records);
+    }
+    if (totalRecords <= MFT_RECORD_ROOT) return nullptr;
+
+    // Decode all records in parallel; every record has a fixed slot so only
+    // attributes that spilled into extension records need a merge afterwards
+    std::vector<MftRecord> records(totalRecords);
+    const unsigned int workers = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::vector<MftExtension>> extensions(workers);
+    std::atomic<size_t> nextChunk = 0;
+    std::vector<std::thread> threads;
+    for (unsigned int worker = 0; worker < workers; worker++)
+    {
+        threads.emplace_back([&, worker]
+        {
+            const MftFile file(path);
+            std::vector<BYTE> buffer(static_cast<size_t>(chunkRecords) * recordSize);
+            for (size_t c = nextChunk++; file.IsOpen() && c < chunks.size(); c = nextChunk++)
+            {
+                const auto& chunk = chunks[c];
+                const DWORD read = file.Read(chunk.Offset, buffer.data(), static_cast<DWORD>(chunk.Records * recordSize));
+                MftDecodeRecords(buffer.data(), read, recordSize, chunk.FirstRecord, records, extensions[worker]);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    for (auto& list : extensions) MftMergeExtensions(records, list);
+    const std::vector<MftNode> nodes = MftBuildTree(records);
+
+    // Create the items in the same order so each parent already exists
+    std::vector<CItem*> items(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const MftNode& node = nodes[i];
+        const auto& info = records[node.Record];
+        const ITEMTYPE type = (i == 0 ? (offline ? IT_DIRECTORY | ITF_OFFLINE : IT_DRIVE) | ITF_ROOTITEM :
+            info.IsDirectory ? IT_DIRECTORY : IT_FILE) | ITF_DONE;
+        items[i] = i == 0 ?
+            ::new CItem(type, rootName, ToFileTime(node.LastChange), node.SizePhysical, node.SizeLogical, info.Attributes, node.Files, node.Folders) :
+            new (items[node.Parent]) CItem(type, info.Names[node.Name].Name, ToFileTime(node.LastChange), node.SizePhysical, node.SizeLogical, info.Attributes, node.Files, node.Folders);
+        if (CReparsePoints::IsReparsePoint(info.Attributes)) items[i]->SetReparseTag(info.ReparseTag);
+        if (i > 0) items[node.Parent]->AddChild(items[i], true);
+    }
+
+    for (const auto& item : items)
+    {
+        if (!item->TmiIsLeaf()) item->SortItemsBySizePhysical();
+    }
+
+    return items.front();
+}
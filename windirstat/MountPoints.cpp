@@ -26,29 +26,24 @@
 #include "FileFind.h"
 #include "GlobalHelpers.h"
 
-#include <algorithm>
-
-bool CReparsePoints::IsReparseType(const std::wstring & longpath, const std::unordered_set<DWORD>& tagTypes, const bool mask)
+DWORD CReparsePoints::GetReparseTag(const std::wstring& longpath)
 {
     SmartPointer<HANDLE> handle(CloseHandle, CreateFile(longpath.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ,
         nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr));
     if (handle == INVALID_HANDLE_VALUE)
     {
-        return false;
+        return 0;
     }
 
-    std::vector<BYTE> buf(MAXIMUM_REPARSE_DATA_BUFFER_SIZE);
-    DWORD dwRet = MAXIMUM_REPARSE_DATA_BUFFER_SIZE;
-    if (DeviceIoControl(handle, FSCTL_GET_REPARSE_POINT,
-        nullptr, 0, buf.data(), MAXIMUM_REPARSE_DATA_BUFFER_SIZE, &dwRet, nullptr) == FALSE)
+    // Only the tag is needed so the reparse data itself is not read
+    FILE_ATTRIBUTE_TAG_INFO info;
+    if (GetFileInformationByHandleEx(handle, FileAttributeTagInfo, &info, sizeof(info)) == FALSE ||
+        (info.FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
     {
-        return false;
+        return 0;
     }
 
-    // Test if the tag matches the types or mask that was passed
-    const DWORD tag = reinterpret_cast<PREPARSE_GUID_DATA_BUFFER>(buf.data())->ReparseTag;
-    return std::ranges::any_of(tagTypes, [tag, mask](const DWORD& tagType) {
-        return (mask && (tag & tagType) == tag) || (!mask && tag == tagType); });
+    return info.ReparseTag;
 }
 
 void CReparsePoints::Initialize()
@@ -95,11 +90,11 @@ void CReparsePoints::Initialize()
                 name[len - 1] = wds::chrNull;
             }
 
-            if (IsReparseType(name, { IO_REPARSE_TAG_MOUNT_POINT }))
+            if (GetReparseTag(name) == IO_REPARSE_TAG_MOUNT_POINT)
             {
                 _wcslwr_s(name, len + 1);
-                m_Mountpoints.emplace_back(name);
-                m_Mountpoints.emplace_back(FileFindEnhanced::MakeLongPathCompatible(name));
+                m_Mountpoints.emplace(name);
+                m_Mountpoints.emplace(FileFindEnhanced::MakeLongPathCompatible(name));
             }
         }
     }
@@ -119,31 +114,26 @@ bool CReparsePoints::IsDirectoryReparsePoint(const DWORD attr)
         (attr & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
 }
 
-bool CReparsePoints::IsVolumeMountPoint(const std::wstring& longpath, DWORD attr) const
+bool CReparsePoints::IsVolumeMountPoint(const std::wstring& longpath, const DWORD attr, const DWORD tag) const
 {
-    if (attr == INVALID_FILE_ATTRIBUTES) attr = ::GetFileAttributes(longpath.c_str());
-    if (!IsDirectoryReparsePoint(attr)) return false;
+    if (!IsDirectoryReparsePoint(attr) || tag != IO_REPARSE_TAG_MOUNT_POINT) return false;
     std::wstring lowerpath = longpath;
-    return std::ranges::find(m_Mountpoints, MakeLower(lowerpath)) != m_Mountpoints.end();
+    return m_Mountpoints.contains(MakeLower(lowerpath));
 }
 
-bool CReparsePoints::IsJunction(const std::wstring& longpath, DWORD attr) const
+bool CReparsePoints::IsJunction(const std::wstring& longpath, const DWORD attr, const DWORD tag) const
 {
-    if (attr == INVALID_FILE_ATTRIBUTES) attr = ::GetFileAttributes(longpath.c_str());
-    if (!IsDirectoryReparsePoint(attr)) return false;
-    return !IsVolumeMountPoint(longpath) && IsReparseType(longpath, { IO_REPARSE_TAG_MOUNT_POINT });
+    return IsDirectoryReparsePoint(attr) && tag == IO_REPARSE_TAG_MOUNT_POINT &&
+        !IsVolumeMountPoint(longpath, attr, tag);
 }
 
-bool CReparsePoints::IsSymbolicLink(const std::wstring& longpath, DWORD attr)
+bool CReparsePoints::IsSymbolicLink(const DWORD attr, const DWORD tag)
 {
-    if (attr == INVALID_FILE_ATTRIBUTES) attr = ::GetFileAttributes(longpath.c_str());
-    if (!IsReparsePoint(attr)) return false;
-    return IsReparseType(longpath, { IO_REPARSE_TAG_SYMLINK });
+    return IsReparsePoint(attr) && tag == IO_REPARSE_TAG_SYMLINK;
 }
 
-bool CReparsePoints::IsCloudLink(const std::wstring& longpath, DWORD attr)
+bool CReparsePoints::IsCloudLink(const DWORD attr, const DWORD tag)
 {
-    if (attr == INVALID_FILE_ATTRIBUTES) attr = ::GetFileAttributes(longpath.c_str());
-    if (!IsReparsePoint(attr)) return false;
-    return IsReparseType(longpath, { IO_REPARSE_TAG_CLOUD_MASK }, true);
+    // Cloud tags carry a provider specific value in the bits of the cloud mask
+    return IsReparsePoint(attr) && (tag & ~IO_REPARSE_TAG_CLOUD_MASK) == IO_REPARSE_TAG_CLOUD;
 }
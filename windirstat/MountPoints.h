@@ -25,18 +25,23 @@
 #include <unordered_set>
 #include <vector>
 
+//
+// CReparsePoints. Classifies reparse points from their attributes and reparse
+// tag. The tag is normally delivered by the directory enumeration so only the
+// mount point lookup needs the path.
+//
 class CReparsePoints final
 {
-    std::vector<std::wstring> m_Mountpoints;
+    std::unordered_set<std::wstring> m_Mountpoints; // Lower case, with and without long path prefix
 
 public:
 
     void Initialize();
-    bool IsVolumeMountPoint(const std::wstring& longpath, DWORD attr = INVALID_FILE_ATTRIBUTES) const;
-    bool IsJunction(const std::wstring& longpath, DWORD attr = INVALID_FILE_ATTRIBUTES) const;
-    static bool IsSymbolicLink(const std::wstring& longpath, DWORD attr = INVALID_FILE_ATTRIBUTES);
-    static bool IsCloudLink(const std::wstring& longpath, DWORD attr = INVALID_FILE_ATTRIBUTES);
-    static bool IsReparseType(const std::wstring& longpath, const std::unordered_set<DWORD>& tagTypes, bool mask = false);
+    bool IsVolumeMountPoint(const std::wstring& longpath, DWORD attr, DWORD tag) const;
+    bool IsJunction(const std::wstring& longpath, DWORD attr, DWORD tag) const;
+    static bool IsSymbolicLink(DWORD attr, DWORD tag);
+    static bool IsCloudLink(DWORD attr, DWORD tag);
+    static DWORD GetReparseTag(const std::wstring& longpath);
     static bool IsDirectoryReparsePoint(DWORD attr);
     static bool IsReparsePoint(DWORD attr);
 };
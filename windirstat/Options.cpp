@@ -50,6 +50,12 @@ Setting<bool> COptions::ListGrid(OptionsGeneral, L"ListGrid", false);
 Setting<bool> COptions::ListStripes(OptionsGeneral, L"ListStripes", false);
 Setting<bool> COptions::PacmanAnimation(OptionsGeneral, L"PacmanAnimation", true);
 Setting<bool> COptions::ScanForDuplicates(OptionsDupeTree, L"ScanForDuplicates", false);
+Setting<bool> COptions::ScanningAutoTune(OptionsGeneral, L"ScanningAutoTune", true);
+Setting<bool> COptions::ScanningCache(OptionsGeneral, L"ScanningCache", false);
+Setting<bool> COptions::ScanningMergeRefresh(OptionsGeneral, L"ScanningMergeRefresh", true);
+Setting<bool> COptions::ScanningOwners(OptionsGeneral, L"ScanningOwners", false);
+Setting<bool> COptions::ScanningReadAhead(OptionsGeneral, L"ScanningReadAhead", true);
+Setting<bool> COptions::ScanningWorkStealing(OptionsGeneral, L"ScanningWorkStealing", true);
 Setting<bool> COptions::ShowColumnAttributes(OptionsFileTree, L"ShowColumnAttributes", false);
 Setting<bool> COptions::ShowColumnFiles(OptionsFileTree, L"ShowColumnFiles", true);
 Setting<bool> COptions::ShowColumnFolders(OptionsFileTree, L"ShowColumnFolders", false);
@@ -70,6 +76,7 @@ Setting<bool> COptions::SkipDupeDetectionCloudLinks(OptionsGeneral, L"SkipDupeDe
 Setting<bool> COptions::TreeMapGrid(OptionsTreeMap, L"TreeMapGrid", (CTreeMap::GetDefaults().grid));
 Setting<bool> COptions::UseBackupRestore(OptionsGeneral, L"UseBackupRestore", true);
 Setting<bool> COptions::UseFallbackLocale(OptionsGeneral, L"UseFallbackLocale", false);
+Setting<bool> COptions::WatchForChanges(OptionsGeneral, L"WatchForChanges", false);
 Setting<COLORREF> COptions::FileTreeColor0(OptionsFileTree, L"FileTreeColor0", RGB(64, 64, 140));
 Setting<COLORREF> COptions::FileTreeColor1(OptionsFileTree, L"FileTreeColor1", RGB(140, 64, 64));
 Setting<COLORREF> COptions::FileTreeColor2(OptionsFileTree, L"FileTreeColor2", RGB(64, 140, 64));
@@ -84,6 +91,7 @@ Setting<double> COptions::MainSplitterPos(OptionsGeneral, L"MainSplitterPos", -1
 Setting<double> COptions::SubSplitterPos(OptionsGeneral, L"SubSplitterPos", -1.0, 0.0, 1.0);
 Setting<int> COptions::ConfigPage(OptionsGeneral, L"ConfigPage", 0);
 Setting<int> COptions::LanguageId(OptionsGeneral, L"LanguageId", 0);
+Setting<int> COptions::ReclaimPendingItems(OptionsGeneral, L"ReclaimPendingItems", 20'000'000, 0, INT_MAX);
 Setting<int> COptions::ScanningThreads(OptionsGeneral, L"ScanningThreads", 4, 1, 16);
 Setting<int> COptions::SelectDrivesRadio(OptionsDriveSelect, L"SelectDrivesRadio", 0, 0, 2);
 Setting<int> COptions::FileTreeColorCount(OptionsFileTree, L"FileTreeColorCount", 8);
@@ -106,6 +114,7 @@ Setting<std::vector<int>> COptions::ExtViewColumnOrder(OptionsExtView, L"ExtView
 Setting<std::vector<int>> COptions::ExtViewColumnWidth(OptionsExtView, L"ExtViewColumnWidth");
 Setting<std::vector<std::wstring>> COptions::SelectDrivesDrives(OptionsDriveSelect, L"SelectDrivesDrives");
 Setting<std::wstring> COptions::SelectDrivesFolder(OptionsDriveSelect, L"SelectDrivesFolder");
+Setting<std::wstring> COptions::ScanStatisticsFile(OptionsGeneral, L"ScanStatisticsFile");
 Setting<WINDOWPLACEMENT> COptions::MainWindowPlacement(OptionsGeneral, L"MainWindowPlacement");
 
 CTreeMap::Options COptions::TreeMapOptions;
@@ -120,6 +120,12 @@ public:
     static Setting<bool> ListStripes;
     static Setting<bool> PacmanAnimation;
     static Setting<bool> ScanForDuplicates;
+    static Setting<bool> ScanningAutoTune;
+    static Setting<bool> ScanningCache;
+    static Setting<bool> ScanningMergeRefresh;
+    static Setting<bool> ScanningOwners;
+    static Setting<bool> ScanningReadAhead;
+    static Setting<bool> ScanningWorkStealing;
     static Setting<bool> ShowColumnAttributes;
     static Setting<bool> ShowColumnFiles;
     static Setting<bool> ShowColumnFolders;
@@ -140,6 +146,7 @@ public:
     static Setting<bool> TreeMapGrid;
     static Setting<bool> UseBackupRestore;
     static Setting<bool> UseFallbackLocale;
+    static Setting<bool> WatchForChanges;
     static Setting<COLORREF> FileTreeColor0;
     static Setting<COLORREF> FileTreeColor1;
     static Setting<COLORREF> FileTreeColor2;
@@ -155,6 +162,7 @@ public:
     static Setting<int> ConfigPage;
     static Setting<int> FollowReparsePointMask;
     static Setting<int> LanguageId;
+    static Setting<int> ReclaimPendingItems;
     static Setting<int> ScanningThreads;
     static Setting<int> SelectDrivesRadio;
     static Setting<int> FileTreeColorCount;
@@ -177,6 +185,7 @@ public:
     static Setting<std::vector<int>> ExtViewColumnWidth;
     static Setting<std::vector<std::wstring>> SelectDrivesDrives;
     static Setting<std::wstring> SelectDrivesFolder;
+    static Setting<std::wstring> ScanStatisticsFile;
     static Setting<WINDOWPLACEMENT> MainWindowPlacement;
 
     static CTreeMap::Options TreeMapOptions;
@@ -0,0 +1,113 @@
+// OwnerCache.cpp - Implementation of COwnerCache
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "OwnerCache.h"
+#include "Item.h"
+#include "SmartPointer.h"
+#include <common/CommonHelpers.h>
+
+#include <aclapi.h>
+#include <algorithm>
+#include <execution>
+#include <limits>
+
+COwnerCache* COwnerCache::Get()
+{
+    static COwnerCache cache;
+    return &cache;
+}
+
+COwnerCache::Index COwnerCache::Intern(const PSID sid)
+{
+    if (sid == nullptr || !IsValidSid(sid)) return 0;
+    const auto bytes = static_cast<const char*>(sid);
+    const std::string key(bytes, bytes + GetLengthSid(sid));
+
+    {
+        std::shared_lock lock(m_Mutex);
+        if (const auto index = m_Indexes.find(key); index != m_Indexes.end()) return index->second;
+    }
+
+    std::lock_guard lock(m_Mutex);
+    if (const auto index = m_Indexes.find(key); index != m_Indexes.end()) return index->second;
+
+    // Owners beyond the index range are looked up by path every time
+    if (m_Owners.size() > std::numeric_limits<Index>::max()) return 0;
+    const auto index = static_cast<Index>(m_Owners.size());
+    m_Owners.emplace_back().Sid.assign(key.begin(), key.end());
+    m_Indexes.emplace(key, index);
+    return index;
+}
+
+COwnerCache::Index COwnerCache::QueryOwner(const std::wstring& longpath)
+{
+    SmartPointer<PSECURITY_DESCRIPTOR> ps(LocalFree);
+    PSID sid = nullptr;
+    if (GetNamedSecurityInfo(longpath.c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION,
+        &sid, nullptr, nullptr, nullptr, &ps) != ERROR_SUCCESS) return 0;
+    return Intern(sid);
+}
+
+std::wstring COwnerCache::GetName(const Index index)
+{
+    std::vector<BYTE> sid;
+    {
+        std::shared_lock lock(m_Mutex);
+        if (index == 0 || index >= m_Owners.size()) return {};
+        const auto& owner = m_Owners[index];
+        if (owner.Resolved) return owner.Name;
+        sid = owner.Sid;
+    }
+
+    // The account lookup may go to a domain controller so it is done unlocked;
+    // concurrent lookups of the same owner just produce the same name
+    std::wstring name = GetNameFromSid(sid.data());
+    std::lock_guard lock(m_Mutex);
+    m_Owners[index].Name = name;
+    m_Owners[index].Resolved = true;
+    return name;
+}
+
+void COwnerCache::ResolveOwners(const std::vector<CItem*>& items)
+{
+    std::for_each(std::execution::par, items.begin(), items.end(), [this](CItem* item)
+    {
+        if (item->GetOwnerIndex() == 0 && item->IsType(IT_FILE | IT_DIRECTORY))
+        {
+            item->SetOwnerIndex(QueryOwner(item->GetPathLong()));
+        }
+    });
+
+    // Resolve the names of the distinct owners up front as well
+    std::vector<Index> indexes;
+    {
+        std::shared_lock lock(m_Mutex);
+        for (size_t i = 1; i < m_Owners.size(); i++)
+        {
+            if (!m_Owners[i].Resolved) indexes.push_back(static_cast<Index>(i));
+        }
+    }
+
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [this](const Index index)
+    {
+        GetName(index);
+    });
+}
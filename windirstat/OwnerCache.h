@@ -0,0 +1,66 @@
+// OwnerCache.h - Declaration of COwnerCache
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CItem;
+
+//
+// COwnerCache. Interns the owner SIDs of files so items only store a small
+// index, and resolves every distinct SID to its account name only once per
+// process. Index 0 means the owner is not known.
+//
+class COwnerCache final
+{
+public:
+    using Index = unsigned short;
+
+    COwnerCache(const COwnerCache&) = delete;
+    COwnerCache& operator=(const COwnerCache&) = delete;
+
+    static COwnerCache* Get();
+
+    // Reads the owner of a file or folder; 0 if it cannot be read
+    Index QueryOwner(const std::wstring& longpath);
+    std::wstring GetName(Index index);
+
+    // Fetches the owners of all items that do not have one yet in parallel
+    void ResolveOwners(const std::vector<CItem*>& items);
+
+private:
+    COwnerCache() = default;
+    Index Intern(PSID sid);
+
+    struct Owner
+    {
+        std::vector<BYTE> Sid;
+        std::wstring Name;
+        bool Resolved = false;
+    };
+
+    std::shared_mutex m_Mutex;
+    std::unordered_map<std::string, Index> m_Indexes; // Keyed by the binary SID
+    std::vector<Owner> m_Owners = std::vector<Owner>(1);
+};
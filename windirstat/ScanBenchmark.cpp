@@ -0,0 +1,330 @@
+// ScanBenchmark.cpp - Implementation of CScanBenchmark
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "ScanBenchmark.h"
+#include "CsvLoader.h"
+#include "HeadlessScan.h"
+#include "Item.h"
+#include "Options.h"
+#include "ScanCache.h"
+#include "ScanStatistics.h"
+#include "SmartPointer.h"
+#include "WinDirStat.h"
+
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <stack>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+    constexpr std::array EXTENSIONS = { L".txt", L".dat", L".log", L".jpg", L".png", L".cpp", L".h", L".bin" };
+
+    std::wstring RandomName(std::mt19937_64& random, const unsigned int length)
+    {
+        std::uniform_int_distribution<int> letter(L'a', L'z');
+        std::wstring name(length, L'\0');
+        for (auto& c : name) c = static_cast<WCHAR>(letter(random));
+        return name;
+    }
+}
+
+bool CScanBenchmark::IsRequested()
+{
+    return __argc > 1 && (_wcsicmp(__wargv[1], L"/benchmark") == 0 || _wcsicmp(__wargv[1], L"-benchmark") == 0);
+}
+
+bool CScanBenchmark::ParseArguments()
+{
+    m_Threads = COptions::ScanningThreads;
+    for (int i = 2; i < __argc; i++)
+    {
+        const std::wstring arg = __wargv[i];
+        const auto value = [&]() { return i + 1 < __argc ? wcstoull(__wargv[++i], nullptr, 10) : 0ull; };
+        if (_wcsicmp(arg.c_str(), L"/depth") == 0) m_Depth = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/fanout") == 0) m_FanOut = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/files") == 0) m_FilesPerFolder = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/namemin") == 0) m_NameMin = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/namemax") == 0) m_NameMax = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/sizemax") == 0) m_SizeMax = value();
+        else if (_wcsicmp(arg.c_str(), L"/duplicates") == 0) m_Duplicates = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/seed") == 0) m_Seed = value();
+        else if (_wcsicmp(arg.c_str(), L"/threads") == 0) m_Threads = static_cast<unsigned int>(value());
+        else if (_wcsicmp(arg.c_str(), L"/out") == 0 && i + 1 < __argc) m_OutputFile = __wargv[++i];
+        else if (_wcsicmp(arg.c_str(), L"/keep") == 0) m_Keep = true;
+        else if (arg.starts_with(L'/') || !m_Folder.empty()) return false;
+        else m_Folder = arg;
+    }
+
+    if (m_Folder.empty() || m_Threads == 0 || m_NameMin == 0 || m_NameMin > m_NameMax || m_Duplicates > 100) return false;
+
+    // The tree gets its own folder so nothing else is ever removed afterward
+    while (!m_Folder.empty() && m_Folder.back() == L'\\') m_Folder.pop_back();
+    m_Folder += std::format(L"\\WinDirStat Benchmark {}", m_Seed);
+    return true;
+}
+
+bool CScanBenchmark::CreateSyntheticFile(const std::wstring& path, const ULONGLONG size, const ULONGLONG contentSeed)
+{
+    SmartPointer<HANDLE> file(CloseHandle, CreateFile(FileFindEnhanced::MakeLongPathCompatible(path).c_str(),
+        GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr));
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    // Contents only depend on their seed so duplicates are byte for byte identical
+    thread_local std::vector<ULONGLONG> buffer;
+    buffer.resize(static_cast<std::size_t>((size + sizeof(ULONGLONG) - 1) / sizeof(ULONGLONG)));
+    std::mt19937_64 content(contentSeed);
+    for (auto& word : buffer) word = content();
+
+    DWORD written = 0;
+    return size == 0 || ::WriteFile(file, buffer.data(), static_cast<DWORD>(size), &written, nullptr) && written == size;
+}
+
+bool CScanBenchmark::Generate()
+{
+    std::mt19937_64 random(m_Seed);
+    std::uniform_int_distribution<unsigned int> nameLength(m_NameMin, m_NameMax);
+    std::uniform_int_distribution<std::size_t> extension(0, EXTENSIONS.size() - 1);
+    std::uniform_int_distribution<unsigned int> percent(0, 99);
+    std::uniform_real_distribution<double> logSize(0.0, std::log(static_cast<double>(m_SizeMax) + 1.0));
+
+    // Sizes are log-uniform so small files dominate like on real volumes
+    std::vector<std::pair<ULONGLONG, ULONGLONG>> originals; // Size and content seed
+    std::stack<std::pair<std::wstring, unsigned int>> folders({ { m_Folder, 0 } });
+    while (!folders.empty())
+    {
+        const auto [folder, level] = folders.top();
+        folders.pop();
+        if (!CreateDirectory(FileFindEnhanced::MakeLongPathCompatible(folder).c_str(), nullptr)) return false;
+        m_GeneratedFolders++;
+
+        for (unsigned int f = 0; f < m_FilesPerFolder; f++)
+        {
+            ULONGLONG size;
+            ULONGLONG contentSeed;
+            if (!originals.empty() && percent(random) < m_Duplicates)
+            {
+                std::uniform_int_distribution<std::size_t> original(0, originals.size() - 1);
+                std::tie(size, contentSeed) = originals[original(random)];
+                m_GeneratedDuplicates++;
+            }
+            else
+            {
+                size = static_cast<ULONGLONG>(std::exp(logSize(random))) - 1;
+                contentSeed = random();
+                originals.emplace_back(size, contentSeed);
+            }
+
+            // The index keeps names unique whatever their random part
+            const std::wstring name = std::format(L"{}{}{}", RandomName(random, nameLength(random)), f, EXTENSIONS[extension(random)]);
+            if (!CreateSyntheticFile(folder + L"\\" + name, size, contentSeed)) return false;
+            m_GeneratedFiles++;
+            m_GeneratedBytes += size;
+        }
+
+        for (unsigned int d = 0; level < m_Depth && d < m_FanOut; d++)
+        {
+            folders.emplace(std::format(L"{}\\{}{}", folder, RandomName(random, nameLength(random)), d), level + 1);
+        }
+    }
+
+    return true;
+}
+
+ULONGLONG CScanBenchmark::FindDuplicates(CItem* root)
+{
+    // Group by size first and then narrow down by partial and full hashes
+    // exactly like the duplicate detection of the GUI does
+    std::unordered_map<ULONGLONG, std::vector<CItem*>> sizes;
+    for (std::stack<CItem*> queue({ root }); !queue.empty();)
+    {
+        CItem* item = queue.top();
+        queue.pop();
+        if (item->IsType(IT_FILE))
+        {
+            if (item->GetSizeLogical() > 0) sizes[item->GetSizeLogical()].push_back(item);
+            continue;
+        }
+        for (const auto& child : item->GetChildren()) queue.push(child);
+    }
+
+    constexpr auto partialBufferSize = 128ull * 1024ull;
+    BlockingQueue<CItem*> queue; // Never suspended; only passed to the hashing
+    ULONGLONG duplicates = 0;
+    for (auto& candidates : sizes | std::views::values)
+    {
+        if (candidates.size() < 2) continue;
+
+        std::unordered_map<std::wstring, std::vector<CItem*>> partial;
+        for (const auto& item : candidates) partial[item->GetFileHash(partialBufferSize, &queue)].push_back(item);
+        for (auto& [partialHash, matches] : partial)
+        {
+            if (matches.size() < 2 || partialHash.empty()) continue;
+
+            std::unordered_map<std::wstring, ULONGLONG> full;
+            for (const auto& item : matches)
+            {
+                // Files no larger than the partial hash are already fully hashed
+                const auto hash = item->GetSizeLogical() <= partialBufferSize ? partialHash : item->GetFileHash(0, &queue);
+                if (!hash.empty()) full[hash]++;
+            }
+            for (const auto& count : full | std::views::values)
+            {
+                if (count > 1) duplicates += count - 1;
+            }
+        }
+    }
+
+    return duplicates;
+}
+
+bool CScanBenchmark::SaveJson() const
+{
+    std::ofstream out(m_OutputFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    std::string phases;
+    for (const auto& [name, microseconds] : m_Phases)
+    {
+        phases += std::format(R"({}"{}":{})", phases.empty() ? "" : ",", name, microseconds);
+    }
+
+    out << std::format(R"({{"build":"{}","parameters":{{"depth":{},"fanOut":{},"filesPerFolder":{},"nameMin":{},)"
+        R"("nameMax":{},"sizeMax":{},"duplicatePercent":{},"seed":{},"threads":{}}},)"
+        R"("tree":{{"folders":{},"files":{},"bytes":{},"duplicates":{},"duplicatesFound":{}}},)"
+        R"("memory":{{"items":{},"arenaBytes":{},"itemSize":{}}},)"
+        R"("phaseMicroseconds":{{{}}}}})", GIT_COMMIT, m_Depth, m_FanOut, m_FilesPerFolder, m_NameMin,
+        m_NameMax, m_SizeMax, m_Duplicates, m_Seed, m_Threads, m_GeneratedFolders, m_GeneratedFiles,
+        m_GeneratedBytes, m_GeneratedDuplicates, m_FoundDuplicates, m_ScannedItems, m_ScannedArenaBytes,
+        sizeof(CItem), phases) << "\n";
+    return out.good();
+}
+
+int CScanBenchmark::Run()
+{
+    AttachConsole(ATTACH_PARENT_PROCESS);
+
+    if (!ParseArguments())
+    {
+        CHeadlessScan::Print(L"Usage: windirstat.exe /benchmark folder [/depth N] [/fanout N] [/files N] [/namemin N] [/namemax N] "
+            L"[/sizemax N] [/duplicates PERCENT] [/seed N] [/threads N] [/out benchmark.json] [/keep]");
+        return CHeadlessScan::ExitUsage;
+    }
+    if (FileFindEnhanced::DoesFileExist(m_Folder))
+    {
+        CHeadlessScan::Print(std::format(L"Benchmark folder already exists: {}", m_Folder));
+        return CHeadlessScan::ExitUsage;
+    }
+
+    CDirStatApp::Get()->ReReadMountPoints();
+
+    // Cached listings would make the scan phases depend on earlier runs
+    CScanCache::Get()->SetReadEnabled(false);
+
+    const auto phase = [this](const char* name, const std::function<void()>& work)
+    {
+        const ULONGLONG start = CScanStatistics::Now();
+        work();
+        m_Phases.emplace_back(name, CScanStatistics::Now() - start);
+        CHeadlessScan::Print(std::format(L"{:<16} {:>12} us", std::wstring(name, name + strlen(name)), m_Phases.back().second));
+    };
+
+    bool generated = false;
+    phase("generate", [&] { generated = Generate(); });
+    if (!generated)
+    {
+        CHeadlessScan::Print(std::format(L"Could not generate the tree in: {}", m_Folder));
+        std::error_code ec;
+        if (!m_Keep) std::filesystem::remove_all(m_Folder, ec);
+        return CHeadlessScan::ExitOutputFailed;
+    }
+
+    const std::unique_ptr<CItem> root(::new CItem(IT_DIRECTORY | ITF_ROOTITEM, m_Folder));
+    root->UpdateStatsFromDisk();
+    const ULONGLONG arenaBytes = CItemArena::GetTotalBytes() - CItemArena::GetFreeBytes();
+    phase("scan", [&]
+    {
+        CHeadlessScan::Scan({ root.get() }, m_Threads);
+        CItem::ScanItemsFinalize(root.get());
+    });
+
+    // Measured from what the arenas hold, so names and child information count as well
+    m_ScannedItems = root->GetItemsCount();
+    m_ScannedArenaBytes = CItemArena::GetTotalBytes() - CItemArena::GetFreeBytes() - arenaBytes;
+    CHeadlessScan::Print(std::format(L"{:<16} {:>12} bytes per item ({} items, {} bytes per CItem)", L"memory",
+        m_ScannedItems > 0 ? m_ScannedArenaBytes / m_ScannedItems : 0, m_ScannedItems, sizeof(CItem)));
+    phase("refresh", [&]
+    {
+        CHeadlessScan::Scan({ root.get() }, m_Threads);
+        CItem::ScanItemsFinalize(root.get());
+    });
+
+    // Compare enumerating with and without read-ahead on fresh trees; the
+    // scans above warmed the file system cache for both alike
+    const bool readAhead = COptions::ScanningReadAhead;
+    for (const bool enabled : { true, false })
+    {
+        COptions::ScanningReadAhead = enabled;
+        const std::unique_ptr<CItem> fresh(::new CItem(IT_DIRECTORY | ITF_ROOTITEM, m_Folder));
+        fresh->UpdateStatsFromDisk();
+        phase(enabled ? "scanReadAhead" : "scanSynchronous", [&]
+        {
+            CHeadlessScan::Scan({ fresh.get() }, m_Threads);
+            CItem::ScanItemsFinalize(fresh.get());
+        });
+    }
+    COptions::ScanningReadAhead = readAhead;
+    phase("duplicates", [&] { m_FoundDuplicates = FindDuplicates(root.get()); });
+
+    const std::wstring csv = m_Folder + L".csv";
+    bool saved = false;
+    phase("saveCsv", [&] { saved = SaveResults(csv, root.get()); });
+    phase("loadCsv", [&] { delete LoadResults(csv); });
+    phase("extensions", [&]
+    {
+        CExtensionData extensions;
+        root->CollectExtensionData(&extensions);
+    });
+
+    int exitCode = saved ? CHeadlessScan::ExitSuccess : CHeadlessScan::ExitOutputFailed;
+    if (!m_OutputFile.empty() && !SaveJson())
+    {
+        CHeadlessScan::Print(std::format(L"Could not write results: {}", m_OutputFile));
+        exitCode = CHeadlessScan::ExitOutputFailed;
+    }
+
+    if (!m_Keep)
+    {
+        std::error_code ec;
+        std::filesystem::remove(csv, ec);
+        std::filesystem::remove_all(m_Folder, ec);
+    }
+
+    return exitCode;
+}
@@ -0,0 +1,75 @@
+// ScanBenchmark.h - Declaration of CScanBenchmark
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class CItem;
+
+//
+// CScanBenchmark. Materializes a synthetic tree below the given folder and
+// times the scanning engine on it without creating any windows:
+//
+//   windirstat.exe /benchmark folder [/depth N] [/fanout N] [/files N]
+//       [/namemin N] [/namemax N] [/sizemax N] [/duplicates PERCENT]
+//       [/seed N] [/threads N] [/out benchmark.json] [/keep]
+//
+// The tree only depends on the parameters, so runs of the same build on the
+// same parameters are comparable. Phases and their timing are written as JSON.
+//
+class CScanBenchmark final
+{
+public:
+    static bool IsRequested();
+    int Run();
+
+private:
+    bool ParseArguments();
+    bool Generate();
+    static bool CreateSyntheticFile(const std::wstring& path, ULONGLONG size, ULONGLONG contentSeed);
+    static ULONGLONG FindDuplicates(CItem* root);
+    bool SaveJson() const;
+
+    std::wstring m_Folder;
+    std::wstring m_OutputFile;
+    unsigned int m_Depth = 3;
+    unsigned int m_FanOut = 8;
+    unsigned int m_FilesPerFolder = 32;
+    unsigned int m_NameMin = 4;
+    unsigned int m_NameMax = 24;
+    ULONGLONG m_SizeMax = 16 * 1024;
+    unsigned int m_Duplicates = 10; // Percent of files that copy an earlier file
+    ULONGLONG m_Seed = 1;
+    unsigned int m_Threads = 0;
+    bool m_Keep = false;
+
+    // Results
+    ULONGLONG m_GeneratedFolders = 0;
+    ULONGLONG m_GeneratedFiles = 0;
+    ULONGLONG m_GeneratedBytes = 0;
+    ULONGLONG m_GeneratedDuplicates = 0;
+    ULONGLONG m_FoundDuplicates = 0;
+    ULONGLONG m_ScannedItems = 0;
+    ULONGLONG m_ScannedArenaBytes = 0; // Arena bytes held by the scanned tree
+    std::vector<std::pair<std::string, ULONGLONG>> m_Phases; // Name and microseconds
+};
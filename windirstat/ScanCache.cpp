@@ -0,0 +1,298 @@
+// ScanCache.cpp - Implementation of CScanCache
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "ScanCache.h"
+#include <common/Tracer.h>
+
+#include <ShlObj.h>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace
+{
+    constexpr DWORD CACHE_MAGIC = 'CSDW';
+    constexpr DWORD CACHE_VERSION = 2;
+
+    // Bounds for counts read back from a possibly truncated or corrupt file
+    constexpr ULONG MAX_DIRECTORY_ENTRIES = 1 << 24;
+    constexpr size_t MIN_ENTRY_BYTES = sizeof(FileFindEntry::Attributes) + sizeof(FileFindEntry::SizeLogical) +
+        sizeof(FileFindEntry::SizePhysical) + sizeof(FileFindEntry::LastWriteTime) + sizeof(FileFindEntry::FileId) +
+        sizeof(FileFindEntry::ReparseTag) + sizeof(USHORT);
+
+    // Points the entry names at their storage once a directory is complete
+    void LinkNames(CScanCache::Directory& directory)
+    {
+        for (size_t i = 0; i < directory.Entries.size(); i++)
+        {
+            directory.Entries[i].Name = directory.Names[i];
+        }
+    }
+
+    template <typename T> void Write(std::ofstream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T> bool Read(std::ifstream& in, T& value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    //
+    // FileFindBackendCached. Wraps the platform backend: unchanged directories are
+    // served from the cache after opening them, all others are enumerated and the
+    // complete listing is recorded for the next run.
+    //
+    class FileFindBackendCached final : public FileFindBackend
+    {
+        CScanCache& m_Cache;
+        std::unique_ptr<FileFindBackend> m_Inner = FileFindBackend::Create();
+        CScanCache::Key m_Key = {};
+        std::shared_ptr<const CScanCache::Directory> m_Hit;
+        std::shared_ptr<CScanCache::Directory> m_Recording;
+        bool m_Served = false;
+
+    public:
+        explicit FileFindBackendCached(CScanCache& cache) : m_Cache(cache) {}
+
+        bool Open(const std::wstring& path, const DirectoryHandle& parent) override
+        {
+            if (!m_Inner->Open(path, parent)) return false;
+
+            FILETIME lastWrite;
+            if (!m_Inner->GetIdentity(m_Key.Volume, m_Key.FileId, lastWrite)) return true;
+
+            m_Hit = m_Cache.Lookup(m_Key, lastWrite);
+            if (m_Hit == nullptr)
+            {
+                m_Recording = std::make_shared<CScanCache::Directory>();
+                m_Recording->LastWrite = lastWrite;
+            }
+            return true;
+        }
+
+        bool ReadBatch(const std::wstring& pattern, const bool restart, std::vector<FileFindEntry>& entries) override
+        {
+            // Only complete listings are cached
+            if (!pattern.empty()) m_Recording.reset();
+
+            if (m_Hit != nullptr && pattern.empty())
+            {
+                entries.clear();
+                if (m_Served) return false;
+                m_Served = true;
+                entries = m_Hit->Entries;
+                return !entries.empty();
+            }
+
+            const bool success = m_Inner->ReadBatch(pattern, restart, entries);
+            if (m_Recording == nullptr) return success;
+
+            if (success)
+            {
+                for (const auto& entry : entries)
+                {
+                    m_Recording->Names.emplace_back(entry.Name);
+                    m_Recording->Entries.push_back(entry);
+                }
+            }
+            else
+            {
+                if (m_Inner->IsExhausted())
+                {
+                    LinkNames(*m_Recording);
+                    m_Cache.Store(m_Key, std::move(m_Recording));
+                }
+                m_Recording.reset();
+            }
+
+            return success;
+        }
+
+        bool GetIdentity(DWORD& volumeSerial, ULONGLONG& fileId, FILETIME& lastWrite) override
+        {
+            return m_Inner->GetIdentity(volumeSerial, fileId, lastWrite);
+        }
+
+        DirectoryHandle GetDirectoryHandle() const override
+        {
+            return m_Inner->GetDirectoryHandle();
+        }
+
+        bool IsExhausted() const override
+        {
+            return m_Hit != nullptr ? m_Served : m_Inner->IsExhausted();
+        }
+    };
+}
+
+CScanCache* CScanCache::Get()
+{
+    static CScanCache cache;
+    return &cache;
+}
+
+std::unique_ptr<FileFindBackend> CScanCache::CreateBackend()
+{
+    return std::make_unique<FileFindBackendCached>(*this);
+}
+
+std::shared_ptr<const CScanCache::Directory> CScanCache::Lookup(const Key& key, const FILETIME& lastWrite)
+{
+    {
+        std::shared_lock lock(m_Mutex);
+        const auto directory = m_Directories.find(key);
+        if (!m_ReadEnabled || directory == m_Directories.end() || CompareFileTime(&directory->second->LastWrite, &lastWrite) != 0)
+        {
+            m_Misses++;
+            return nullptr;
+        }
+    }
+
+    // Retake exclusively to record the directory as still present
+    std::lock_guard lock(m_Mutex);
+    m_Used.insert(key);
+    m_Hits++;
+    return m_Directories.at(key);
+}
+
+void CScanCache::Store(const Key& key, std::shared_ptr<Directory> directory)
+{
+    std::lock_guard lock(m_Mutex);
+    m_Directories.insert_or_assign(key, std::move(directory));
+    m_Used.insert(key);
+}
+
+std::wstring CScanCache::GetCacheFile()
+{
+    PWSTR folder = nullptr;
+    if (SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &folder) != S_OK) return {};
+    std::wstring path = std::wstring(folder) + L"\\WinDirStat";
+    CoTaskMemFree(folder);
+
+    std::error_code ec;
+    std::filesystem::create_directories(path, ec);
+    return path + L"\\ScanCache.dat";
+}
+
+void CScanCache::Load()
+{
+    std::lock_guard lock(m_Mutex);
+    if (m_Loaded) return;
+    m_Loaded = true;
+
+    const std::wstring path = GetCacheFile();
+    std::error_code error;
+    const ULONGLONG fileSize = std::filesystem::file_size(path, error);
+    if (error) return;
+
+    std::ifstream in(path, std::ios::binary);
+    DWORD magic = 0, version = 0;
+    ULONGLONG count = 0;
+    if (!Read(in, magic) || magic != CACHE_MAGIC || !Read(in, version) ||
+        version != CACHE_VERSION || !Read(in, count)) return;
+
+    // Counts are checked against what is left of the file before anything is
+    // allocated for them; a cache that still cannot be read is dropped as a whole
+    const auto remaining = [&]
+    {
+        const auto position = static_cast<ULONGLONG>(in.tellg());
+        return position < fileSize ? fileSize - position : 0;
+    };
+
+    try
+    {
+        for (ULONGLONG d = 0; d < count; d++)
+        {
+            Key key;
+            ULONG entries = 0;
+            auto directory = std::make_shared<Directory>();
+            if (!Read(in, key.Volume) || !Read(in, key.FileId) ||
+                !Read(in, directory->LastWrite) || !Read(in, entries)) break;
+            if (entries > MAX_DIRECTORY_ENTRIES || entries > remaining() / MIN_ENTRY_BYTES) break;
+
+            directory->Names.resize(entries);
+            directory->Entries.resize(entries);
+            for (ULONG e = 0; e < entries && in; e++)
+            {
+                auto& entry = directory->Entries[e];
+                USHORT length = 0;
+                Read(in, entry.Attributes);
+                Read(in, entry.SizeLogical);
+                Read(in, entry.SizePhysical);
+                Read(in, entry.LastWriteTime);
+                Read(in, entry.FileId);
+                Read(in, entry.ReparseTag);
+                if (!Read(in, length) || length * sizeof(WCHAR) > remaining())
+                {
+                    in.setstate(std::ios::failbit);
+                    break;
+                }
+                directory->Names[e].resize(length);
+                in.read(reinterpret_cast<char*>(directory->Names[e].data()), length * sizeof(WCHAR));
+            }
+            if (!in) break;
+
+            LinkNames(*directory);
+            m_Directories.emplace(key, std::move(directory));
+        }
+    }
+    catch (const std::exception&)
+    {
+        VTRACE(L"Scan cache discarded");
+        m_Directories.clear();
+        return;
+    }
+
+    VTRACE(L"Scan cache loaded: {} directories", m_Directories.size());
+}
+
+void CScanCache::Save()
+{
+    std::shared_lock lock(m_Mutex);
+    std::ofstream out(GetCacheFile(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return;
+
+    // Directories not seen during this session no longer exist or were not scanned
+    Write(out, CACHE_MAGIC);
+    Write(out, CACHE_VERSION);
+    Write(out, static_cast<ULONGLONG>(m_Used.size()));
+    for (const auto& key : m_Used)
+    {
+        const auto& directory = m_Directories.at(key);
+        Write(out, key.Volume);
+        Write(out, key.FileId);
+        Write(out, directory->LastWrite);
+        Write(out, static_cast<ULONG>(directory->Entries.size()));
+        for (const auto& entry : directory->Entries)
+        {
+            Write(out, entry.Attributes);
+            Write(out, entry.SizeLogical);
+            Write(out, entry.SizePhysical);
+            Write(out, entry.LastWriteTime);
+            Write(out, entry.FileId);
+            Write(out, entry.ReparseTag);
+            Write(out, static_cast<USHORT>(entry.Name.size()));
+            out.write(reinterpret_cast<const char*>(entry.Name.data()), entry.Name.size() * sizeof(WCHAR));
+        }
+    }
+}
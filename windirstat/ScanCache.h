@@ -0,0 +1,94 @@
+// ScanCache.h - Declaration of CScanCache
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include "FileFind.h"
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//
+// CScanCache. Persists the raw entries of every enumerated directory keyed by
+// volume serial number and directory file id. A directory whose last write
+// time is unchanged since it was stored is served from the cache instead of
+// being enumerated again. Only directories seen during the last session are
+// written back so the cache does not accumulate deleted directories.
+//
+class CScanCache final
+{
+public:
+    struct Key
+    {
+        DWORD Volume;
+        ULONGLONG FileId;
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<ULONGLONG>()(key.FileId ^ static_cast<ULONGLONG>(key.Volume) << 48);
+        }
+    };
+
+    struct Directory
+    {
+        FILETIME LastWrite = { 0, 0 };
+        std::vector<std::wstring> Names;    // Storage for the entry names
+        std::vector<FileFindEntry> Entries; // Names refer into the storage above
+    };
+
+    CScanCache(const CScanCache&) = delete;
+    CScanCache& operator=(const CScanCache&) = delete;
+
+    static CScanCache* Get();
+
+    std::unique_ptr<FileFindBackend> CreateBackend();
+    std::shared_ptr<const Directory> Lookup(const Key& key, const FILETIME& lastWrite);
+    void Store(const Key& key, std::shared_ptr<Directory> directory);
+    void Load();
+    void Save();
+
+    // Refreshes bypass cached listings but still record what they enumerate
+    void SetReadEnabled(const bool enabled) { m_ReadEnabled = enabled; }
+
+    ULONGLONG GetHits() const { return m_Hits; }
+    ULONGLONG GetMisses() const { return m_Misses; }
+    void ResetCounters() { m_Hits = 0; m_Misses = 0; }
+
+private:
+    CScanCache() = default;
+    static std::wstring GetCacheFile();
+
+    std::shared_mutex m_Mutex;
+    std::unordered_map<Key, std::shared_ptr<const Directory>, KeyHash> m_Directories;
+    std::unordered_set<Key, KeyHash> m_Used;
+    std::atomic<ULONGLONG> m_Hits = 0;
+    std::atomic<ULONGLONG> m_Misses = 0;
+    std::atomic<bool> m_ReadEnabled = true;
+    bool m_Loaded = false;
+};
@@ -0,0 +1,54 @@
+// ScanObserver.h - Declaration of CScanObserver
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include "BlockingQueue.h"
+
+#include <vector>
+
+class CItem;
+
+//
+// CScanObserver. Receives the changes the scanning engine makes to the item
+// tree. The document registers itself to forward them to the views; without
+// an observer (headless scans) the engine does no presentation work at all.
+// All callbacks may be invoked from scanning threads and return only once
+// the change is handled, so anything that touches the views or the document
+// state owned by the message thread (like the zoom) has to be marshalled
+// there by the observer; the engine keeps no locks while calling it.
+//
+class CScanObserver
+{
+public:
+    virtual ~CScanObserver() = default;
+
+    virtual void OnChildAdded(CItem* parent, CItem* child) = 0;
+    virtual void OnChildrenAdded(CItem* parent, const std::vector<CItem*>& children) = 0;
+    virtual void OnChildRemoved(CItem* parent, CItem* child) = 0; // Called before the child is deleted
+    virtual void OnRemovingAllChildren(CItem* parent) = 0;
+
+    // Files whose contents take part in duplicate detection
+    virtual void OnDuplicateCandidate(CItem* item, BlockingQueue<CItem*>* queue) = 0;
+    virtual void OnDuplicateCandidateRemoved(CItem* item) = 0;
+
+    // Folder whose subtree is enumerated ahead of the rest; may be null
+    virtual const CItem* GetPriorityItem() const = 0;
+};
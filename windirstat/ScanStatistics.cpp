@@ -0,0 +1,238 @@
+// ScanStatistics.cpp - Implementation of CScanStatistics
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "ScanStatistics.h"
+#include "GlobalHelpers.h"
+#include "Localization.h"
+#include "ScanCache.h"
+#include "langs.h"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <fstream>
+
+// Registers the counters of a thread on first use and unregisters them when it exits
+struct CScanStatistics::Registration
+{
+    Counters Local;
+
+    Registration()
+    {
+        std::lock_guard lock(Get()->m_Mutex);
+        Get()->m_Threads.push_back(&Local);
+    }
+
+    ~Registration()
+    {
+        std::lock_guard lock(Get()->m_Mutex);
+        std::erase(Get()->m_Threads, &Local);
+    }
+};
+
+namespace
+{
+    void Accumulate(CScanStatistics::Totals& totals, const CScanStatistics::Counters& counters)
+    {
+        totals.Directories += counters.Directories;
+        totals.Entries += counters.Entries;
+        totals.BytesHashed += counters.BytesHashed;
+        totals.IdleMicroseconds += counters.IdleMicroseconds;
+        totals.EnumerationCalls += counters.EnumerationCalls;
+        for (std::size_t i = 0; i < CScanStatistics::LATENCY_BUCKETS; i++)
+        {
+            totals.Latency[i] += counters.Latency[i];
+        }
+    }
+
+    std::string ToJson(const CScanStatistics::Totals& totals)
+    {
+        std::string latency;
+        for (const auto& bucket : totals.Latency)
+        {
+            latency += std::format("{}{}", latency.empty() ? "" : ",", bucket);
+        }
+
+        return std::format(R"({{"directories":{},"entries":{},"bytesHashed":{},"idleMicroseconds":{},)"
+            R"("enumerationCalls":{},"enumerationLatency":[{}]}})", totals.Directories, totals.Entries,
+            totals.BytesHashed, totals.IdleMicroseconds, totals.EnumerationCalls, latency);
+    }
+
+    std::string EscapeJson(const std::wstring& text)
+    {
+        std::string escaped;
+        for (const char c : std::string(CW2A(text.c_str(), CP_UTF8)))
+        {
+            if (c == '\\' || c == '"') escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+CScanStatistics* CScanStatistics::Get()
+{
+    static CScanStatistics statistics;
+    return &statistics;
+}
+
+ULONGLONG CScanStatistics::Now()
+{
+    static const LONGLONG frequency = []
+    {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return value.QuadPart;
+    }();
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<ULONGLONG>(counter.QuadPart / frequency * 1000000 +
+        counter.QuadPart % frequency * 1000000 / frequency);
+}
+
+CScanStatistics::Counters& CScanStatistics::Local()
+{
+    thread_local Registration registration;
+    return registration.Local;
+}
+
+void CScanStatistics::RecordEnumeration(const ULONGLONG microseconds)
+{
+    Counters& counters = Local();
+    const auto bucket = std::min<std::size_t>(std::bit_width(microseconds >> 1), LATENCY_BUCKETS - 1);
+    Add(counters.EnumerationCalls, 1);
+    Add(counters.Latency[bucket], 1);
+}
+
+void CScanStatistics::Start(const std::vector<std::wstring>& roots)
+{
+    std::lock_guard lock(m_Mutex);
+    for (const auto& counters : m_Threads)
+    {
+        counters->Directories = 0;
+        counters->Entries = 0;
+        counters->BytesHashed = 0;
+        counters->IdleMicroseconds = 0;
+        counters->EnumerationCalls = 0;
+        for (auto& bucket : counters->Latency) bucket = 0;
+    }
+
+    m_Roots = roots;
+    m_Queues.clear();
+    m_Start = Now();
+    m_Stop = 0;
+    m_LastStatus = {};
+}
+
+void CScanStatistics::SetQueues(const std::vector<BlockingQueue<CItem*>*>& queues)
+{
+    std::lock_guard lock(m_Mutex);
+    m_Queues = queues;
+}
+
+void CScanStatistics::Stop()
+{
+    std::lock_guard lock(m_Mutex);
+    m_Queues.clear();
+    m_Stop = Now();
+}
+
+CScanStatistics::Snapshot CScanStatistics::GetSnapshot()
+{
+    std::lock_guard lock(m_Mutex);
+    Snapshot snapshot;
+    snapshot.ElapsedMicroseconds = (m_Stop != 0 ? m_Stop : Now()) - m_Start;
+    for (const auto& queue : m_Queues)
+    {
+        snapshot.QueueDepth += queue->GetPending();
+    }
+
+    for (const auto& counters : m_Threads)
+    {
+        // Threads that have not done anything during this scan are left out
+        Totals totals;
+        Accumulate(totals, *counters);
+        if (totals.Directories == 0 && totals.BytesHashed == 0 && totals.IdleMicroseconds == 0) continue;
+        Accumulate(snapshot.All, *counters);
+        snapshot.Threads.push_back(totals);
+    }
+
+    return snapshot;
+}
+
+std::wstring CScanStatistics::GetStatusText()
+{
+    // Rates cover the time since the last update so they follow the scan as it progresses
+    const Snapshot current = GetSnapshot();
+    const double seconds = std::max(1.0, static_cast<double>(current.ElapsedMicroseconds - m_LastStatus.ElapsedMicroseconds)) / 1000000.0;
+    const auto rate = [seconds](const ULONGLONG now, const ULONGLONG last)
+    {
+        return static_cast<ULONGLONG>(static_cast<double>(now - std::min(now, last)) / seconds);
+    };
+
+    const double busy = seconds * 1000000.0 * static_cast<double>(std::max<std::size_t>(current.Threads.size(), 1));
+    const auto idle = static_cast<int>(100.0 * static_cast<double>(current.All.IdleMicroseconds -
+        std::min(current.All.IdleMicroseconds, m_LastStatus.All.IdleMicroseconds)) / busy);
+
+    std::wstring text = L"     " + Localization::Format(IDS_SCANSTATISTICSsssss,
+        FormatCount(rate(current.All.Directories, m_LastStatus.All.Directories)),
+        FormatCount(rate(current.All.Entries, m_LastStatus.All.Entries)),
+        FormatBytes(rate(current.All.BytesHashed, m_LastStatus.All.BytesHashed)),
+        FormatCount(current.QueueDepth),
+        std::to_wstring(std::clamp(idle, 0, 100)) + L"%");
+
+    // Folders served from the scan cache are what it saves
+    if (const auto hits = CScanCache::Get()->GetHits(), misses = CScanCache::Get()->GetMisses(); hits + misses > 0)
+    {
+        text += L"   " + Localization::Format(IDS_SCANSTATISTICS_CACHEss, FormatCount(hits), FormatCount(misses));
+    }
+
+    m_LastStatus = current;
+    return text;
+}
+
+bool CScanStatistics::SaveJson(const std::wstring& path)
+{
+    const Snapshot snapshot = GetSnapshot();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    std::string roots;
+    {
+        std::lock_guard lock(m_Mutex);
+        for (const auto& root : m_Roots)
+        {
+            roots += std::format(R"({}"{}")", roots.empty() ? "" : ",", EscapeJson(root));
+        }
+    }
+
+    std::string threads;
+    for (const auto& totals : snapshot.Threads)
+    {
+        threads += std::format("{}{}", threads.empty() ? "" : ",", ToJson(totals));
+    }
+
+    out << std::format(R"({{"build":"{}","roots":[{}],"elapsedMicroseconds":{},"totals":{},)"
+        R"("scanCache":{{"hits":{},"misses":{}}},"threads":[{}]}})", GIT_COMMIT, roots, snapshot.ElapsedMicroseconds,
+        ToJson(snapshot.All), CScanCache::Get()->GetHits(), CScanCache::Get()->GetMisses(), threads) << "\n";
+    return out.good();
+}
@@ -0,0 +1,108 @@
+// ScanStatistics.h - Declaration of CScanStatistics
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include "BlockingQueue.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CItem;
+
+//
+// CScanStatistics. Throughput counters of the scanning engine. Every thread
+// counts into its own cache line without any locked instructions and the
+// counters are only summed when they are displayed or saved at scan end.
+//
+class CScanStatistics final
+{
+public:
+    // Bucket i counts enumeration calls that took less than 2^(i+1) microseconds
+    static constexpr std::size_t LATENCY_BUCKETS = 16;
+
+    struct alignas(64) Counters
+    {
+        std::atomic<ULONGLONG> Directories = 0;
+        std::atomic<ULONGLONG> Entries = 0;
+        std::atomic<ULONGLONG> BytesHashed = 0;
+        std::atomic<ULONGLONG> IdleMicroseconds = 0;
+        std::atomic<ULONGLONG> EnumerationCalls = 0;
+        std::array<std::atomic<ULONGLONG>, LATENCY_BUCKETS> Latency = {};
+    };
+
+    struct Totals
+    {
+        ULONGLONG Directories = 0;
+        ULONGLONG Entries = 0;
+        ULONGLONG BytesHashed = 0;
+        ULONGLONG IdleMicroseconds = 0;
+        ULONGLONG EnumerationCalls = 0;
+        std::array<ULONGLONG, LATENCY_BUCKETS> Latency = {};
+    };
+
+    struct Snapshot
+    {
+        ULONGLONG ElapsedMicroseconds = 0;
+        std::size_t QueueDepth = 0;
+        Totals All;
+        std::vector<Totals> Threads;
+    };
+
+    CScanStatistics(const CScanStatistics&) = delete;
+    CScanStatistics& operator=(const CScanStatistics&) = delete;
+
+    static CScanStatistics* Get();
+    static ULONGLONG Now();
+
+    // Counting is only done by the thread owning the counters
+    static void Add(std::atomic<ULONGLONG>& counter, const ULONGLONG value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static Counters& Local();
+    static void RecordEnumeration(ULONGLONG microseconds);
+
+    void Start(const std::vector<std::wstring>& roots);
+    void SetQueues(const std::vector<BlockingQueue<CItem*>*>& queues);
+    void Stop();
+
+    Snapshot GetSnapshot();
+    std::wstring GetStatusText();
+    bool SaveJson(const std::wstring& path);
+
+private:
+    CScanStatistics() = default;
+
+    struct Registration;
+    friend struct Registration;
+
+    std::mutex m_Mutex;
+    std::vector<Counters*> m_Threads;
+    std::vector<BlockingQueue<CItem*>*> m_Queues;
+    std::vector<std::wstring> m_Roots;
+    ULONGLONG m_Start = 0;
+    ULONGLONG m_Stop = 0;
+    Snapshot m_LastStatus;
+};
@@ -0,0 +1,157 @@
+// ScanTuner.cpp - Implementation of CScanTuner
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "stdafx.h"
+#include "ScanTuner.h"
+#include "Options.h"
+#include <common/Tracer.h>
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+    constexpr auto SAMPLE_INTERVAL = std::chrono::milliseconds(500);
+    constexpr int SAMPLE_COUNT = 20;          // Tuning window of about ten seconds
+    constexpr double REQUIRED_GAIN = 1.10;    // A change must gain ten percent to be kept
+}
+
+CScanTuner::CScanTuner(const std::vector<BlockingQueue<CItem*>*>& queues) : m_Budget(GetThreadBudget())
+{
+    for (const auto& queue : queues)
+    {
+        m_Volumes.push_back({ .Queue = queue, .BestThreads = queue->GetActiveWorkerThreads() });
+    }
+}
+
+CScanTuner::~CScanTuner()
+{
+    Stop();
+}
+
+void CScanTuner::Start()
+{
+    m_Thread = std::thread([this] { Run(); });
+}
+
+void CScanTuner::Stop()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Stopped.notify_all();
+    if (m_Thread.joinable()) m_Thread.join();
+}
+
+unsigned int CScanTuner::GetThreadBudget()
+{
+    // Shared by all volumes; the configured count stays a lower bound on machines with few processors
+    return std::max(static_cast<unsigned int>(COptions::ScanningThreads), std::thread::hardware_concurrency());
+}
+
+unsigned int CScanTuner::GetInitialThreads(const size_t volumes)
+{
+    const auto share = GetThreadBudget() / static_cast<unsigned int>(std::max<size_t>(volumes, 1));
+    return std::clamp(share, 1u, static_cast<unsigned int>(COptions::ScanningThreads));
+}
+
+unsigned int CScanTuner::GetActiveThreads() const
+{
+    unsigned int threads = 0;
+    for (const auto& volume : m_Volumes)
+    {
+        if (!volume.Queue->IsCompleteOrCancelled()) threads += volume.Queue->GetActiveWorkerThreads();
+    }
+    return threads;
+}
+
+void CScanTuner::Step(Volume& volume, const double rate)
+{
+    const unsigned int current = volume.Queue->GetActiveWorkerThreads();
+    if (rate <= volume.BestRate * REQUIRED_GAIN)
+    {
+        // The last change did not pay off; if growing never helped try fewer workers once
+        volume.Queue->SetActiveWorkerThreads(volume.BestThreads);
+        if (!volume.Shrinking && current > volume.BestThreads && volume.BestThreads > 1 &&
+            volume.BestThreads == GetInitialThreads(m_Volumes.size()))
+        {
+            volume.Shrinking = true;
+            volume.Queue->SetActiveWorkerThreads(volume.BestThreads - 1);
+            return;
+        }
+
+        volume.Settled = true;
+        return;
+    }
+
+    volume.BestRate = rate;
+    volume.BestThreads = current;
+    if (volume.Shrinking)
+    {
+        if (current == 1) volume.Settled = true;
+        else volume.Queue->SetActiveWorkerThreads(current - 1);
+        return;
+    }
+
+    // Grow by a quarter so fast media reach their optimum within the window
+    const unsigned int available = m_Budget - std::min(m_Budget, GetActiveThreads());
+    const unsigned int increment = std::min(std::max(current / 4, 1u), available);
+    if (increment == 0) volume.Settled = true;
+    else volume.Queue->SetActiveWorkerThreads(current + increment);
+}
+
+void CScanTuner::Run()
+{
+    for (int sample = 0; sample < SAMPLE_COUNT; sample++)
+    {
+        if (std::unique_lock lock(m_Mutex); m_Stopped.wait_for(lock, SAMPLE_INTERVAL, [this] { return m_Stopping; }))
+        {
+            break;
+        }
+
+        bool tuning = false;
+        for (auto& volume : m_Volumes)
+        {
+            if (volume.Settled) continue;
+            if (volume.Queue->IsCompleteOrCancelled())
+            {
+                volume.Settled = true;
+                continue;
+            }
+
+            // Samples taken while suspended say nothing about the medium
+            const size_t progress = volume.Queue->GetProgress();
+            const double rate = static_cast<double>(progress - volume.LastProgress);
+            volume.LastProgress = progress;
+            tuning = true;
+            if (volume.Queue->IsSuspended()) continue;
+
+            Step(volume, rate);
+        }
+
+        if (!tuning) break;
+    }
+
+    for (const auto& volume : m_Volumes)
+    {
+        VTRACE(L"Scan tuner: {} workers, {} entries per interval", volume.Queue->GetActiveWorkerThreads(), volume.BestRate);
+    }
+}
@@ -0,0 +1,79 @@
+// ScanTuner.h - Declaration of CScanTuner
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include "BlockingQueue.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CItem;
+
+//
+// CScanTuner. Adjusts the number of active workers of each volume queue during
+// the first seconds of a scan. Every volume climbs towards the worker count at
+// which its enumeration rate stops improving, while the sum of active workers
+// over all volumes stays within one shared budget. Queues only start the
+// workers of their initial share and start more as their share grows.
+//
+class CScanTuner final
+{
+public:
+    explicit CScanTuner(const std::vector<BlockingQueue<CItem*>*>& queues);
+    ~CScanTuner();
+
+    CScanTuner(const CScanTuner&) = delete;
+    CScanTuner& operator=(const CScanTuner&) = delete;
+
+    static unsigned int GetThreadBudget();
+    static unsigned int GetInitialThreads(size_t volumes);
+
+    // Tunes on a thread of its own until every volume settled, finished or
+    // the tuning window elapsed; Stop() ends it early and waits for it
+    void Start();
+    void Stop();
+
+private:
+    void Run();
+
+    struct Volume
+    {
+        BlockingQueue<CItem*>* Queue;
+        size_t LastProgress = 0;
+        double BestRate = 0.0;
+        unsigned int BestThreads = 0;
+        bool Shrinking = false;
+        bool Settled = false;
+    };
+
+    void Step(Volume& volume, double rate);
+    unsigned int GetActiveThreads() const;
+
+    std::vector<Volume> m_Volumes;
+    unsigned int m_Budget;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Stopped;
+    bool m_Stopping = false;
+    std::thread m_Thread;
+};
@@ -31,7 +31,10 @@
 #include "DirStatDoc.h"
 #include "TreeMapView.h"
 #include "GlobalHelpers.h"
+#include "HeadlessScan.h"
+#include "ItemArena.h"
 #include "Localization.h"
+#include "ScanBenchmark.h"
 #include "SmartPointer.h"
 
 CIconImageList* GetIconImageList()
@@ -135,15 +138,15 @@ void CDirStatApp::ReReadMountPoints()
     m_ReparsePoints.Initialize();
 }
 
-bool CDirStatApp::IsFollowingAllowed(const std::wstring& longpath, const DWORD attr) const
+bool CDirStatApp::IsFollowingAllowed(const std::wstring& longpath, const DWORD attr, const DWORD tag) const
 {
     // Allow following if not a reparse point, is a reparse point without exclusion controls,
     // or is a reparse point with exclusion controls but are not excluded
     return !CReparsePoints::IsReparsePoint(attr) ||
-        !CReparsePoints::IsReparseType(longpath, { IO_REPARSE_TAG_SYMLINK, IO_REPARSE_TAG_MOUNT_POINT }) ||
-        !COptions::ExcludeVolumeMountPoints && m_ReparsePoints.IsVolumeMountPoint(longpath, attr) ||
-        !COptions::ExcludeJunctions && m_ReparsePoints.IsJunction(longpath, attr) ||
-        !COptions::ExcludeSymbolicLinksDirectory && m_ReparsePoints.IsSymbolicLink(longpath, attr);
+        tag != IO_REPARSE_TAG_SYMLINK && tag != IO_REPARSE_TAG_MOUNT_POINT ||
+        !COptions::ExcludeVolumeMountPoints && m_ReparsePoints.IsVolumeMountPoint(longpath, attr, tag) ||
+        !COptions::ExcludeJunctions && m_ReparsePoints.IsJunction(longpath, attr, tag) ||
+        !COptions::ExcludeSymbolicLinksDirectory && CReparsePoints::IsSymbolicLink(attr, tag);
 }
 
 // Get the alternative colors for compressed and encrypted files/folders.
@@ -189,6 +192,14 @@ std::wstring CDirStatApp::GetCurrentProcessMemoryInfo()
         return wds::strEmpty;
     }
 
+    // Include the part held by item arenas once a tree exists
+    const ULONGLONG itemBytes = CItemArena::GetTotalBytes() - CItemArena::GetFreeBytes();
+    if (itemBytes > 0)
+    {
+        static std::wstring itemsformat = L"     " + Localization::Lookup(IDS_RAMUSAGE_ITEMSss);
+        return Localization::Format(itemsformat, FormatBytes(pmc.WorkingSetSize), FormatBytes(itemBytes));
+    }
+
     static std::wstring memformat = L"     " + Localization::Lookup(IDS_RAMUSAGEs);
     return Localization::Format(memformat, FormatBytes(pmc.WorkingSetSize));
 }
@@ -256,11 +267,28 @@ BOOL CDirStatApp::InitInstance()
     m_bSaveState = FALSE;
 
     CWinAppEx::InitInstance();
-    InitShellManager();
 
     // Load default language just to get bootstrapped
     Localization::LoadResource(MAKELANGID(LANG_ENGLISH, SUBLANG_NEUTRAL));
 
+    // If a local config file is available, use that for settings
+    SetPortableMode(true, true);
+    COptions::LoadAppSettings();
+
+    // Scans requested on the command line run without creating any windows
+    if (CHeadlessScan::IsRequested())
+    {
+        m_HeadlessExitCode = CHeadlessScan().Run();
+        return FALSE;
+    }
+    if (CScanBenchmark::IsRequested())
+    {
+        m_HeadlessExitCode = CScanBenchmark().Run();
+        return FALSE;
+    }
+
+    InitShellManager();
+
     // Initialize visual controls
     constexpr INITCOMMONCONTROLSEX ctrls = { sizeof(INITCOMMONCONTROLSEX) , ICC_STANDARD_CLASSES };
     (void)InitCommonControlsEx(&ctrls);
@@ -269,10 +297,6 @@ BOOL CDirStatApp::InitInstance()
     AfxEnableControlContainer();
     (void)AfxInitRichEdit2();
 
-    // If a local config file is available, use that for settings
-    SetPortableMode(true, true);
-
-    COptions::LoadAppSettings();
     LoadStdProfileSettings(4);
 
     m_PDocTemplate = new CSingleDocTemplate(
@@ -338,6 +362,12 @@ BOOL CDirStatApp::InitInstance()
     return TRUE;
 }
 
+int CDirStatApp::ExitInstance()
+{
+    const int exitCode = CWinAppEx::ExitInstance();
+    return m_HeadlessExitCode.value_or(exitCode);
+}
+
 void CDirStatApp::OnAppAbout()
 {
     StartAboutDialog();
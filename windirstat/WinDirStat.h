@@ -30,6 +30,8 @@
 #include <common/Constants.h>
 #include <common/Tracer.h>
 
+#include <optional>
+
 class CMainFrame;
 class CDirStatApp;
 
@@ -46,13 +48,14 @@ public:
 
     CDirStatApp();
     BOOL InitInstance() override;
+    int ExitInstance() override;
     BOOL LoadState(LPCTSTR, CFrameImpl*) override { return TRUE; }
 
     static bool InPortableMode();
     bool SetPortableMode(bool enable, bool onlyOpen = false);
 
     void ReReadMountPoints();
-    bool IsFollowingAllowed(const std::wstring& longpath, DWORD attr = 1) const;
+    bool IsFollowingAllowed(const std::wstring& longpath, DWORD attr, DWORD tag) const;
     CReparsePoints* GetReparseInfo() { return &m_ReparsePoints; }
 
     COLORREF AltColor() const;           // Coloring of compressed items
@@ -79,6 +82,7 @@ protected:
     COLORREF m_AltColor;              // Coloring of compressed items
     COLORREF m_AltEncryptionColor;    // Coloring of encrypted items
     static CDirStatApp _singleton;    // Singleton application instance
+    std::optional<int> m_HeadlessExitCode; // Set if started for a scan without windows
 #ifdef VTRACE_TO_CONSOLE
     CAutoPtr<CWDSTracerConsole> m_VtraceConsole;
 #endif // VTRACE_TO_CONSOLE
@@ -0,0 +1,147 @@
+// WorkStealingDeque.h - Declaration of WorkStealingDeque
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2024 WinDirStat Team (windirstat.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//
+// WorkStealingDeque. A Chase-Lev deque: the owning worker pushes and pops
+// at the bottom without locking while any other worker may steal from the top.
+// Only trivially copyable values (pointers) are supported. Arrays that have been
+// outgrown are retained until Clear() since a thief may still be reading them;
+// capacities double so together they never exceed the size of the current one.
+//
+template <typename T>
+class WorkStealingDeque final
+{
+    struct Ring
+    {
+        explicit Ring(const std::int64_t capacity) : m_Capacity(capacity), m_Mask(capacity - 1),
+            m_Slots(std::make_unique<std::atomic<T>[]>(static_cast<std::size_t>(capacity))) {}
+
+        T Get(const std::int64_t i) const { return m_Slots[i & m_Mask].load(std::memory_order_relaxed); }
+        void Put(const std::int64_t i, T value) { m_Slots[i & m_Mask].store(value, std::memory_order_relaxed); }
+
+        const std::int64_t m_Capacity;
+        const std::int64_t m_Mask;
+        std::unique_ptr<std::atomic<T>[]> m_Slots;
+    };
+
+    alignas(64) std::atomic<std::int64_t> m_Top = 0;
+    alignas(64) std::atomic<std::int64_t> m_Bottom = 0;
+    std::atomic<Ring*> m_Ring;
+    std::vector<std::unique_ptr<Ring>> m_Rings;
+
+    Ring* Grow(Ring* ring, const std::int64_t bottom, const std::int64_t top)
+    {
+        auto grown = std::make_unique<Ring>(ring->m_Capacity * 2);
+        for (auto i = top; i < bottom; i++) grown->Put(i, ring->Get(i));
+        Ring* result = grown.get();
+        m_Rings.emplace_back(std::move(grown));
+        m_Ring.store(result, std::memory_order_release);
+        return result;
+    }
+
+public:
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque(WorkStealingDeque&&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(WorkStealingDeque&&) = delete;
+    ~WorkStealingDeque() = default;
+
+    explicit WorkStealingDeque(const std::int64_t capacity = 1024)
+    {
+        m_Rings.emplace_back(std::make_unique<Ring>(capacity));
+        m_Ring = m_Rings.back().get();
+    }
+
+    // Owner only
+    void PushBottom(T value)
+    {
+        const auto bottom = m_Bottom.load(std::memory_order_relaxed);
+        const auto top = m_Top.load(std::memory_order_acquire);
+        Ring* ring = m_Ring.load(std::memory_order_relaxed);
+        if (bottom - top > ring->m_Capacity - 1) ring = Grow(ring, bottom, top);
+
+        ring->Put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only
+    bool PopBottom(T& value)
+    {
+        const auto bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+        const Ring* ring = m_Ring.load(std::memory_order_relaxed);
+        m_Bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = m_Top.load(std::memory_order_relaxed);
+
+        // Deque was already empty
+        if (top > bottom)
+        {
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // More than one item so no thief can race us for this one
+        value = ring->Get(bottom);
+        if (top < bottom) return true;
+
+        // Last item so race any thieves for it
+        const bool won = m_Top.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    // Any thread
+    bool Steal(T& value)
+    {
+        auto top = m_Top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto bottom = m_Bottom.load(std::memory_order_acquire);
+        if (top >= bottom) return false;
+
+        const Ring* ring = m_Ring.load(std::memory_order_acquire);
+        value = ring->Get(top);
+        return m_Top.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool Empty() const
+    {
+        return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+    }
+
+    // Only valid while no workers are running
+    void Clear()
+    {
+        m_Rings.erase(m_Rings.begin(), m_Rings.end() - 1);
+        m_Ring = m_Rings.back().get();
+        m_Top = 0;
+        m_Bottom = 0;
+    }
+};
@@ -240,6 +240,15 @@
 #define IDS_MENU_CLEANUP_DISK_CLEANUP   20234
 #define IDS_MENU_CLEANUP_REMOVE_ROAMING 20235
 #define IDS_MENU_CLEANUP_DISM_RESET     20236
+#define IDS_MENU_FILE_LOAD_MFT          20237
+#define IDS_SCANSTATISTICSsssss         20238
+#define IDS_MENU_FILE_SAVE_SLOWEST      20239
+#define IDS_SLOWEST_RANKING             20240
+#define IDS_SLOWEST_OWN_TIME            20241
+#define IDS_SLOWEST_FILESYSTEM_TIME     20242
+#define IDS_SLOWEST_SUBTREE_TIME        20243
+#define IDS_RAMUSAGE_ITEMSss            20244
+#define IDS_SCANSTATISTICS_CACHEss      20245
 
 // Next default values for new objects
 // 
@@ -172,6 +172,8 @@
 #define ID_CLEANUP_DISM_NORMAL          33057
 #define ID_CLEANUP_DISM_RESET           33058
 #define ID_CLEANUP_REMOVE_ROAMING       33060
+#define ID_LOAD_MFT                     33061
+#define ID_SAVE_SLOWEST                 33062
 #define IDS_AUTHOR_EMAIL                57345
 #define IDS_URL_WEBSITE                 57346
 #define IDS_URL_HELP                    57347
@@ -182,7 +184,7 @@
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        954
-#define _APS_NEXT_COMMAND_VALUE         33061
+#define _APS_NEXT_COMMAND_VALUE         33063
 #define _APS_NEXT_CONTROL_VALUE         1236
 #define _APS_NEXT_SYMED_VALUE           109
 #endif